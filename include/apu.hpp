@@ -1,3 +1,5 @@
+#include "blip.hpp"
+
 #include <cstdint>
 
 class Length {
@@ -40,7 +42,9 @@ public:
   void trigger();
   void disable();
   bool active();
-  int16_t tick();
+  int16_t sample();
+  uint32_t stepCycles();
+  void run(uint32_t cycles);
   void calcFrequency();
   void clockSweep();
   void clockEnvelope();
@@ -84,7 +88,9 @@ public:
   void trigger();
   void disable();
   bool active();
-  int16_t tick();
+  int16_t sample();
+  uint32_t stepCycles();
+  void run(uint32_t cycles);
   constexpr uint8_t LEN_MASK() override { return 0xff; }
 
 private:
@@ -99,6 +105,9 @@ private:
   bool dacOn;
   uint16_t dutyTimer;
   uint8_t index;
+  uint8_t sampleIndex;  // index when output was last sampled, between the two ticks of a cycle
+
+  void advance(uint32_t ticks);
 };
 
 class CH4 : public Length {
@@ -111,7 +120,9 @@ public:
   void trigger();
   void disable();
   bool active();
-  int16_t tick();
+  int16_t sample();
+  uint32_t stepCycles();
+  void run(uint32_t cycles);
   void clockEnvelope();
 
 private:
@@ -132,7 +143,8 @@ private:
   uint16_t lfsr;
 };
 
-class APU {
+// Sink is the class deriving from APU<Sink>, which receives audio samples
+template<class Sink> class APU {
 public:
   APU() {
     // reset channels upon initialization
@@ -146,15 +158,50 @@ public:
 
     // reset internal state
     subdiv = 0x00;
+    apuTime = 0;
+    levelLeft = 0;
+    levelRight = 0;
+    sampleRate = 32768;
+    blipLeft.setRates(1048576, sampleRate);
+    blipRight.setRates(1048576, sampleRate);
+    for(int i = 0; i < 4; i++) {
+      gain[i] = 256;
+      muted[i] = false;
+    }
+    nr50 = 0x00;
+    nr51 = 0x00;
+    buildMix();
+    synthesis = true;
   }
 
-  virtual void emitSample(int16_t volume) { return; }
+  // sink callbacks, hidden by the Sink class
+  void emitSample(int16_t left, int16_t right) { return; }
+  // block of stereo samples at the output sample rate, interleaved left then right, called every DIV-APU tick
+  void emitSamples(const int16_t* samples, int count) { for(int i = 0; i < count; i++) sink()->emitSample(samples[2 * i], samples[2 * i + 1]); }
+
+  // output sample rate, which takes effect from the next block of samples
+  void setSampleRate(double rate) { sampleRate = rate; }
+  // output samples each step in the waveform is filtered over (8, 16 or 32), trading quality against CPU cost
+  void setFilterLength(int taps) { blipLeft.setTaps(taps); blipRight.setTaps(taps); }
+  // gain of a channel (1-4) from 0 to 256 (full volume), and whether it's muted, e.g. for debugging or ripping tools
+  void setChannelGain(int channel, int level) { gain[(channel - 1) & 3] = (level < 0) ? 0 : (level > 256) ? 256 : level; buildMix(); }
+  void setChannelMute(int channel, bool mute) { muted[(channel - 1) & 3] = mute; buildMix(); }
+  // whether to synthesize audio, which can be skipped when nothing is listening, e.g. in batch runs
+  // note: the registers read back the same either way, as length, sweep and envelope are still clocked by DIV-APU
+  void setAudioEnabled(bool enabled) { synthesis = enabled; }
   uint8_t apuReadIO(uint16_t addr);
   void apuWriteIO(uint16_t addr, uint8_t data);
-  void apuTick();
+  void apuRun(uint32_t cycles);
+  void apuEndFrame();
   void divAPU();
 
 private:
+  Sink* sink() { return static_cast<Sink*>(this); }
+
+  void writeRegister(uint16_t addr, uint8_t data);
+  void apuUpdate(uint32_t time);
+  void buildMix();
+
   // APU channels
   CH1 ch1;
   CH1 ch2;  // note: ch2 should not call ch1-specific functions (readNRx0(), writeNRx0(), clockSweep())
@@ -162,11 +209,26 @@ private:
   CH4 ch4;
 
   // APU registers
-  uint8_t nr50;  // todo: implement panning
-  uint8_t nr51;  // todo: implement panning
+  uint8_t nr50;
+  uint8_t nr51;
   bool nr52;
 
   // APU internal state
   uint8_t subdiv;
+
+  // output synthesis
+  bool synthesis;  // if false, channels aren't stepped through their waveforms and no samples are output
+  int gain[4];
+  bool muted[4];
+  int mixLeft[4];  // weight of each channel in the left output, from panning, master volume and gain, out of 2048
+  int mixRight[4];
+  BlipBuffer blipLeft;
+  BlipBuffer blipRight;
+  double sampleRate;
+  uint32_t apuTime;  // cycles run since the current block of samples started
+  int16_t levelLeft;  // mixed outputs, as last added to blipLeft and blipRight
+  int16_t levelRight;
+  int16_t samples[2 * 1024];
 };
 
+#include "apu.tpp"
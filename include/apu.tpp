@@ -0,0 +1,157 @@
+template<class Sink> uint8_t APU<Sink>::apuReadIO(uint16_t addr) {
+  if(addr == 0xff10) return ch1.readNRx0();  // NR10
+  if(addr == 0xff11) return ch1.readNRx1();  // NR11
+  if(addr == 0xff12) return ch1.readNRx2();  // NR12
+  if(addr == 0xff14) return ch1.readNRx4();  // NR14
+  if(addr == 0xff16) return ch2.readNRx1();  // NR21
+  if(addr == 0xff17) return ch2.readNRx2();  // NR22
+  if(addr == 0xff19) return ch2.readNRx4();  // NR24
+  if(addr == 0xff1a) return ch3.readNRx0();  // NR30
+  if(addr == 0xff1c) return ch3.readNRx2();  // NR32
+  if(addr == 0xff1e) return ch3.readNRx4();  // NR34
+  if(addr == 0xff21) return ch4.readNRx2();  // NR42
+  if(addr == 0xff22) return ch4.readNRx3();  // NR43
+  if(addr == 0xff23) return ch4.readNRx4();  // NR44
+  if(addr == 0xff24) return nr50;  // NR50
+  if(addr == 0xff25) return nr51;  // NR51
+  if(addr == 0xff26) {
+    // NR52
+    uint8_t data = 0x70;
+    if(nr52) data |= 0x80;
+    if(ch4.active()) data |= 0x08;
+    if(ch3.active()) data |= 0x04;
+    if(ch2.active()) data |= 0x02;
+    if(ch1.active()) data |= 0x01;
+    return data;
+  }
+  if(addr >= 0xff30 && addr < 0xff40) return ch3.readRAM(addr);  // wave RAM
+  return 0xff;
+}
+
+template<class Sink> void APU<Sink>::apuWriteIO(uint16_t addr, uint8_t data) {
+  writeRegister(addr, data);
+  apuUpdate(apuTime);
+}
+
+template<class Sink> void APU<Sink>::writeRegister(uint16_t addr, uint8_t data) {
+  if(addr == 0xff1b) { ch3.writeNRx1(data); return; }  // NR31
+  if(addr == 0xff20) { ch4.writeNRx1(data); return; }  // NR41
+  if(addr == 0xff26) {
+    // NR52
+    nr52 = data & 0x80;
+    if(!nr52) {
+      ch1.disable();
+      ch2.disable();
+      ch3.disable();
+      ch4.disable();
+      nr50 = 0x00;
+      nr51 = 0x00;
+      buildMix();
+    }
+    return;
+  }
+  if(addr >= 0xff30 && addr < 0xff40) { ch3.writeRAM(addr, data); return; }  // wave RAM
+
+  // remaining registers are only writable if audio is enabled
+  if(!nr52) return;
+  if(addr == 0xff10) { ch1.writeNRx0(data); return; }  // NR10
+  if(addr == 0xff11) { ch1.writeNRx1(data); return; }  // NR11
+  if(addr == 0xff12) { ch1.writeNRx2(data); return; }  // NR12
+  if(addr == 0xff13) { ch1.writeNRx3(data); return; }  // NR13
+  if(addr == 0xff14) { ch1.writeNRx4(data); return; }  // NR14
+  if(addr == 0xff16) { ch2.writeNRx1(data); return; }  // NR21
+  if(addr == 0xff17) { ch2.writeNRx2(data); return; }  // NR22
+  if(addr == 0xff18) { ch2.writeNRx3(data); return; }  // NR23
+  if(addr == 0xff19) { ch2.writeNRx4(data); return; }  // NR24
+  if(addr == 0xff1a) { ch3.writeNRx0(data); return; }  // NR30
+  if(addr == 0xff1c) { ch3.writeNRx2(data); return; }  // NR32
+  if(addr == 0xff1d) { ch3.writeNRx3(data); return; }  // NR33
+  if(addr == 0xff1e) { ch3.writeNRx4(data); return; }  // NR34
+  if(addr == 0xff21) { ch4.writeNRx2(data); return; }  // NR42
+  if(addr == 0xff22) { ch4.writeNRx3(data); return; }  // NR43
+  if(addr == 0xff23) { ch4.writeNRx4(data); return; }  // NR44
+  if(addr == 0xff24) { nr50 = data; buildMix(); return; }  // NR50
+  if(addr == 0xff25) { nr51 = data; buildMix(); return; }  // NR51
+}
+
+template<class Sink> void APU<Sink>::buildMix() {
+  // route each channel to either side with NR51, scaled by that side's master volume in NR50 (1-8 eighths)
+  int volumeLeft = ((nr50 >> 4) & 0x07) + 1;
+  int volumeRight = (nr50 & 0x07) + 1;
+  for(int i = 0; i < 4; i++) {
+    int level = muted[i] ? 0 : gain[i];
+    mixLeft[i] = (nr51 & (0x10 << i)) ? level * volumeLeft : 0;
+    mixRight[i] = (nr51 & (0x01 << i)) ? level * volumeRight : 0;
+  }
+}
+
+template<class Sink> void APU<Sink>::apuRun(uint32_t cycles) {
+  // run channels from one step of their waveforms to the next, as output only changes on steps
+  // note: waveform position isn't visible to the CPU, so it can be left behind if audio is disabled
+  if(!synthesis) return;
+  while(cycles) {
+    uint32_t step = cycles;
+    if(ch1.stepCycles() < step) step = ch1.stepCycles();
+    if(ch2.stepCycles() < step) step = ch2.stepCycles();
+    if(ch3.stepCycles() < step) step = ch3.stepCycles();
+    if(ch4.stepCycles() < step) step = ch4.stepCycles();
+    ch1.run(step);
+    ch2.run(step);
+    ch3.run(step);
+    ch4.run(step);
+    cycles -= step;
+    apuTime += step;
+    apuUpdate(apuTime - 1);  // output changes on the last cycle run
+  }
+}
+
+template<class Sink> void APU<Sink>::apuUpdate(uint32_t time) {
+  // mix the channels, adding any change in either output as a step on the given cycle
+  if(!synthesis) return;
+  int16_t output[4] = {ch1.sample(), ch2.sample(), ch3.sample(), ch4.sample()};
+  int left = 0;
+  int right = 0;
+  for(int i = 0; i < 4; i++) {
+    left += output[i] * mixLeft[i];
+    right += output[i] * mixRight[i];
+  }
+  left >>= 11;
+  right >>= 11;
+  if(left != levelLeft) blipLeft.addDelta(time, left - levelLeft);
+  if(right != levelRight) blipRight.addDelta(time, right - levelRight);
+  levelLeft = left;
+  levelRight = right;
+}
+
+template<class Sink> void APU<Sink>::apuEndFrame() {
+  // output samples up to the current cycle
+  if(!synthesis) return;
+  blipLeft.endFrame(apuTime);
+  blipRight.endFrame(apuTime);
+  blipLeft.setRates(1048576, sampleRate);
+  blipRight.setRates(1048576, sampleRate);
+  apuTime = 0;
+  while(blipLeft.samplesAvail()) {
+    int count = blipLeft.readSamples(samples, 1024, 2);
+    blipRight.readSamples(samples + 1, count, 2);
+    sink()->emitSamples(samples, count);
+  }
+}
+
+template<class Sink> void APU<Sink>::divAPU() {
+  subdiv++;
+  ch1.divAPU();
+  ch2.divAPU();
+  ch3.divAPU();
+  ch4.divAPU();
+  if(!(subdiv & 0x03)) ch1.clockSweep();
+  if(!(subdiv & 0x07)) {
+    ch1.clockEnvelope();
+    ch2.clockEnvelope();
+    ch4.clockEnvelope();
+  }
+  apuUpdate(apuTime);
+
+  // output a block of samples
+  apuEndFrame();
+}
@@ -0,0 +1,46 @@
+#include <cstdint>
+
+// band-limited synthesis of a signal from amplitude steps, which are resampled to the output rate without aliasing
+// by a polyphase windowed sinc filter, applied 8 taps at a time with AVX2 or SSE2 if enabled
+class BlipBuffer {
+public:
+  BlipBuffer() {
+    setTaps(16);
+    setRates(1, 1);
+    clear();
+  }
+
+  // set the rate of the clock that steps are timed by, and the output sample rate (which must be lower)
+  // note: this is cheap enough to call every frame, e.g. to adjust the output rate to a host's audio clock
+  void setRates(double clockRate, double sampleRate);
+  void clear();
+
+  // set how many output samples each step is spread over (8, 16 or 32), trading the sharpness of the filter
+  // against the cost of each step
+  void setTaps(int count);
+
+  // add a step in amplitude at the given clock cycle of the current frame
+  void addDelta(uint32_t time, int delta);
+
+  // end the current frame after the given number of clock cycles, making its samples available
+  void endFrame(uint32_t time);
+  int samplesAvail() { return avail; }
+
+  // read samples into every stride'th element of out, e.g. with a stride of 2 to interleave two channels
+  int readSamples(int16_t* out, int count, int stride = 1);
+
+private:
+  static constexpr int phases = 32;  // fractional positions each step is resolved to
+  static constexpr int maxTaps = 32;
+  static constexpr int bufferSize = 4096;  // note: frames must end before this many samples are buffered
+
+  void buildKernel();
+
+  uint64_t factor;  // output samples per clock cycle, as 32.32 fixed point
+  uint64_t offset;  // position of the start of the frame in the buffer, as 32.32 fixed point
+  int avail;
+  int taps;  // output samples each step is spread over
+  int32_t integrator;
+  int16_t kernel[phases][maxTaps];  // band-limited impulse at each phase, scaled to sum to 32768
+  int32_t buffer[bufferSize + maxTaps];  // impulses of steps, integrated as samples are read
+};
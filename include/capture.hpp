@@ -0,0 +1,63 @@
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// file formats that audio can be captured to
+enum {
+  CAPTURE_WAV16,  // 16-bit PCM WAV
+  CAPTURE_RAW_FLOAT,  // headerless 32-bit float, native byte order
+  CAPTURE_COUNT
+};
+
+// streams stereo samples to a file, e.g. from emitSamples(), without the emulation thread ever waiting on the disk
+// samples are gathered into large blocks, which a background thread converts and writes
+class AudioCapture {
+public:
+  AudioCapture() {
+    file = NULL;
+    block = NULL;
+    samplesWritten = 0;
+    closing = false;
+  }
+
+  ~AudioCapture() {
+    close();
+  }
+
+  // start a new file, in a CAPTURE_* format, of samples at the given rate
+  void open(const char* path, int fileFormat, int rate);
+  // called by the emulation thread with interleaved left and right samples
+  void write(const int16_t* samples, int count);
+  // write out any buffered samples and finish the file, patching in the WAV header's sizes
+  void close();
+
+private:
+  static constexpr int blockSize = 65536;  // stereo samples per block
+
+  struct Block {
+    int16_t samples[2 * blockSize];
+    int count;
+  };
+
+  void submitBlock();
+  void writerThread();
+  void writeHeader();
+
+  FILE* file;
+  int format;
+  int sampleRate;
+  Block* block;  // being filled by the emulation thread
+  uint64_t samplesWritten;  // by the writer thread
+
+  // shared between the emulation and writer threads
+  std::thread writer;
+  std::mutex lock;
+  std::condition_variable blockReady;
+  std::deque<Block*> fullBlocks;
+  std::vector<Block*> freeBlocks;
+  bool closing;
+};
@@ -1,22 +1,31 @@
+#include <cstddef>
 #include <cstdint>
 
+// note: the cartridge owns its RAM but not its ROM, which may be memory-mapped
 class Cart {
 public:
   ~Cart() {
-    delete[] rom;
     delete[] ram;
   }
 
   uint8_t* getRAM() { return ram; }
   int getSizeRAM() { return ramMask + 1; }
-  void load(uint8_t* cartRom, uint8_t* cartRam, uint32_t cartRamMask) { rom = cartRom; ram = cartRam; ramMask = cartRamMask; return; }
-  virtual uint8_t readROM(uint16_t addr) { return rom[addr & 0x7fff]; }
+  // ROM banks beyond the end of the ROM are mirrored by masking with cartRomMask (its size rounded up to a power of 2, less 1)
+  void load(uint8_t* cartRom, uint32_t cartRomMask, uint8_t* cartRam, uint32_t cartRamMask) { rom = cartRom; romMask = cartRomMask; ram = cartRam; ramMask = cartRamMask; map(); return; }
+  uint8_t readROM(uint16_t addr) { return romMap[(addr >> 14) & 1][addr & 0x3fff]; }
   virtual void writeROM(uint16_t addr, uint8_t data) { return; }
-  virtual uint8_t readRAM(uint16_t addr) { return 0xff; }
-  virtual void writeRAM(uint16_t addr, uint8_t data) { return; }
+  uint8_t readRAM(uint16_t addr) { return ramMap ? ramMap[addr & 0x1fff] : 0xff; }
+  void writeRAM(uint16_t addr, uint8_t data) { if(ramMap) ramMap[addr & 0x1fff] = data; }
+
+  // currently selected banks
+  uint8_t* romMap[2];  // 0x0000-0x3fff and 0x4000-0x7fff
+  uint8_t* ramMap;  // 0xa000-0xbfff, or NULL if RAM is disabled or not present
 
 protected:
+  virtual void map() { romMap[0] = rom; romMap[1] = rom + 0x4000; ramMap = NULL; }
+
   uint8_t* rom;
+  uint32_t romMask;
   uint8_t* ram;
   uint32_t ramMask;
 };
@@ -30,12 +39,11 @@ public:
     mode = false;
   }
 
-  uint8_t readROM(uint16_t addr) override;
   void writeROM(uint16_t addr, uint8_t data) override;
-  uint8_t readRAM(uint16_t addr) override;
-  void writeRAM(uint16_t addr, uint8_t data) override;
 
 private:
+  void map() override;
+
   bool ramg;
   uint8_t bank1;
   uint8_t bank2;
@@ -51,15 +59,13 @@ public:
     ramb = 0x00;
   }
 
-  uint8_t readROM(uint16_t addr) override;
   void writeROM(uint16_t addr, uint8_t data) override;
-  uint8_t readRAM(uint16_t addr) override;
-  void writeRAM(uint16_t addr, uint8_t data) override;
 
 private:
+  void map() override;
+
   bool ramg;
   uint8_t romb0;
   uint8_t romb1;
   uint8_t ramb;
 };
-
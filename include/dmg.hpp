@@ -2,11 +2,20 @@
 #include "ppu.hpp"
 #include "apu.hpp"
 #include "cart.hpp"
+#include "scheduler.hpp"
 
+#include <atomic>
 #include <cstdio>
 #include <cstdlib>
-
-class DMG : public SM83, public PPU, public APU {
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Frontend is the class deriving from DMG<Frontend>, which receives video and audio callbacks
+// without virtual dispatch (see DynamicDMG for a frontend that can be overridden at runtime)
+template<class Frontend> class DMG : public SM83<Frontend>, public PPU<Frontend>, public APU<Frontend> {
 public:
   DMG() {
     rom =  new uint8_t[0x100];
@@ -18,56 +27,145 @@ public:
 
     // reset I/O
     joyp = 0x00;
+    joypadLatch = 0xff;
     sc = 0x00;
-    div = 0x00;
     tima = 0x00;
     tma = 0x00;
     tac = 0x00;
     boot = false;
 
+    // no cartridge inserted yet
+    cart = NULL;
+    cartRom = NULL;
+    cartRomSize = 0;
+    cartRomMapped = false;
+    savePath = NULL;
+
     // reset internal state
     serialBits = 0;
+    divClock = 0;
+    timerClock = 0;
+    clkTimer = false;
     dmaActive = false;
     dmaPending[0] = false;
     dmaPending[1] = false;
+    ppuClock = 0;
+    apuClock = 0;
+    joypadUpdate();
+
+    // schedule initial events
+    divAPUSchedule();
+
+    // set up memory map
+    for(int i = 0; i < 0x100; i++) {
+      readMap[i] = NULL;
+      writeMap[i] = NULL;
+      codeMap[i] = false;
+    }
+    for(int i = 0x80; i < 0xa0; i++) readMap[i] = vram + ((i & 0x1f) << 8);
+    for(int i = 0xc0; i < 0xfe; i++) {
+      readMap[i] = wram + ((i & 0x1f) << 8);
+      writeMap[i] = wram + ((i & 0x1f) << 8);
+    }
+    mapOAM();
   }
 
   ~DMG() {
     delete[] rom;
     delete[] wram;
     delete[] hram;
+    delete[] savePath;
+    delete cart;
+    unloadCartROM();
   }
 
-  void insertCart(Cart* cartridge) { cart = cartridge; }
+  // insert a cartridge set up by the caller, which keeps ownership of its ROM
+  void insertCart(Cart* cartridge) { cart = cartridge; mapCart(); }
   void loadBootROM(char* fname);
-  void cycleIdle() override;
-  uint8_t cycleRead(uint16_t addr) override;
-  void cycleWrite(uint16_t addr, uint8_t data) override;
-  void irqRaiseVBLANK() override { setIF(IF() | 0x01); }
-  void irqRaiseSTAT() override { setIF(IF() | 0x02); }
-
-  virtual uint8_t pollButtons() { return 0xff; }
-  virtual uint8_t pollDpad() { return 0xff; }
+  void loadCart(char* fname);
+  void save();
+  void cycleIdle();
+  void cycleHalt();
+  uint8_t cycleRead(uint16_t addr);
+  void cycleWrite(uint16_t addr, uint8_t data);
+  uint8_t* codePage(uint16_t addr);
+  void protectCode(uint16_t addr);
+  void irqRaiseVBLANK() { setIF(IF() | 0x01); }
+  void irqRaiseSTAT() { setIF(IF() | 0x02); }
+
+  // latch joypad input, as active-low bits 0-3 of JOYP for each half (may be called from any thread)
+  void setJoypad(uint8_t buttons, uint8_t dpad) { joypadLatch = (dpad & 0x0f) << 4 | (buttons & 0x0f); }
+
+  using SM83<Frontend>::instruction;
+  using SM83<Frontend>::reset;
+  using SM83<Frontend>::setIF;
+  using SM83<Frontend>::setIE;
+  using SM83<Frontend>::IF;
+  using SM83<Frontend>::IE;
+  using PPU<Frontend>::vram;
+  using PPU<Frontend>::oam;
 
 private:
+  using SM83<Frontend>::flushCode;
+  using SM83<Frontend>::flushBlock;
+  using PPU<Frontend>::ppuReadIO;
+  using PPU<Frontend>::ppuWriteIO;
+  using PPU<Frontend>::ppuRun;
+  using PPU<Frontend>::ppuNextDots;
+  using PPU<Frontend>::ppuFallback;
+  using PPU<Frontend>::ppuMarkTile;
+  using APU<Frontend>::apuReadIO;
+  using APU<Frontend>::apuWriteIO;
+  using APU<Frontend>::apuRun;
+  using APU<Frontend>::apuEndFrame;
+  using APU<Frontend>::divAPU;
+
+
   void SC(uint8_t data);
+  void DIV();
+  void TIMA(uint8_t data);
+  void TAC(uint8_t data);
   void DMA(uint8_t data);
   uint8_t readBus(uint16_t addr);
   void writeBus(uint16_t addr, uint8_t data);
   uint8_t read8(uint16_t addr);
   void write8(uint16_t addr, uint8_t data);
-  void joypadTick();
+  void mapCart();
+  uint32_t loadCartROM(char* fname);
+  void unloadCartROM();
+  void mapOAM();
+  void codeWritten(uint16_t addr);
+  void joypadSync();
+  void joypadUpdate();
   void cycle();
+  void runEvents();
+
+  // event handlers
+  void ppuSync();
+  void ppuSchedule();
+  void serialEvent();
+  void serialSchedule();
+  void dmaEvent();
+  void apuSync();
+  void divAPUEvent();
+  void divAPUSchedule();
+  bool timerSignal(uint64_t time);
+  uint64_t timerPeriod();
+  void timerSync();
+  void timerSchedule();
 
   // Joypad register
   uint8_t joyp;
 
+  // Joypad internal state
+  std::atomic<uint8_t> joypadLatch;  // d-pad in bits 4-7, buttons in bits 0-3
+  uint8_t joypadState;  // latched input that JOYP was last updated from
+
   // Serial registers
   uint8_t sb;
   uint8_t sc;
 
   // Timer registers
-  uint16_t div;
   uint8_t tima;
   uint8_t tma;
   uint8_t tac;
@@ -82,6 +180,8 @@ private:
   uint8_t serialBits;
 
   // Timer circuit internal state
+  uint64_t divClock;  // cycle on which DIV was last reset
+  uint64_t timerClock;  // cycle up to which TIMA has been updated
   bool clkTimer;
 
   // OAM DMA internal state
@@ -90,10 +190,45 @@ private:
   bool dmaActive;
   uint16_t dmaAddr;
 
+  // PPU internal state
+  uint64_t ppuClock;  // cycle up to which the PPU has been run
+  uint64_t apuClock;  // cycle up to which the APU has been run
+
+  // Event scheduler
+  Scheduler scheduler;
+
+  // Memory map, per 256-byte page (NULL if accesses must go through I/O handlers)
+  uint8_t* readMap[0x100];
+  uint8_t* writeMap[0x100];
+  bool codeMap[0x100];  // page holds cached code, so writes must flush it
+
   // Memory
   Cart* cart;
+  uint8_t* cartRom;  // as loaded by loadCart()
+  size_t cartRomSize;
+  bool cartRomMapped;  // if false, cartRom was allocated
   uint8_t* rom;
   uint8_t* wram;
   uint8_t* hram;
+  char* savePath;
+};
+
+#include "dmg.tpp"
+
+// frontend whose callbacks can be overridden at runtime, e.g. by tools that only link against libdmg
+class DynamicDMG : public DMG<DynamicDMG> {
+public:
+  virtual ~DynamicDMG() {}
+
+  virtual void frame() { return; }
+  virtual void plotPixel(int x, int y, uint8_t data) { return; }
+  virtual void plotLine(int y, const uint8_t* data) { DMG<DynamicDMG>::plotLine(y, data); }
+  virtual void emitSample(int16_t left, int16_t right) { return; }
+  virtual void emitSamples(const int16_t* samples, int count) { DMG<DynamicDMG>::emitSamples(samples, count); }
 };
 
+// instantiated in libdmg
+extern template class SM83<DynamicDMG>;
+extern template class PPU<DynamicDMG>;
+extern template class APU<DynamicDMG>;
+extern template class DMG<DynamicDMG>;
@@ -0,0 +1,481 @@
+template<class Frontend> void DMG<Frontend>::loadBootROM(char* fname) {
+  // load boot ROM
+  FILE* fb = fopen(fname, "rb");
+  if(!fb) {
+    printf("ERROR: %s is not a valid file path\n", fname);
+    exit(0);
+  }
+  fread(rom, sizeof(uint8_t), 0x100, fb);
+  fclose(fb);
+}
+
+template<class Frontend> void DMG<Frontend>::loadCart(char* fname) {
+  // load cartridge ROM
+  uint32_t cartRomMask = loadCartROM(fname);
+  printf("Loaded %s\n", fname);
+
+  // initialize mapper
+  uint8_t mapper = cartRom[0x0147];
+  bool hasRam = false;
+  switch(mapper) {
+  case 0x00:                cart = new Cart(); break;
+  case 0x01:                cart = new MBC1(); break;
+  case 0x02: hasRam = true; cart = new MBC1(); break;
+  case 0x03: hasRam = true; cart = new MBC1(); break;  // todo: has battery
+  case 0x19:                cart = new MBC5(); break;
+  case 0x1a: hasRam = true; cart = new MBC5(); break;
+  case 0x1b: hasRam = true; cart = new MBC5(); break;  // todo: has battery
+  case 0x1c:                cart = new MBC5(); break;  // todo: has rumble
+  case 0x1d: hasRam = true; cart = new MBC5(); break;  // todo: has rumble
+  case 0x1e: hasRam = true; cart = new MBC5(); break;  // todo: has battery and rumble
+  default:
+    printf("ERROR: Unsupported mapper (0x%02x)\n", mapper);
+    exit(0);
+    break;
+  }
+  printf("Mapper: 0x%02x\n", mapper);
+
+  // load cartridge RAM
+  uint8_t* cartRam = NULL;
+  uint32_t cartRamMask = 0x00000;
+  if(hasRam) {
+    switch(cartRom[0x0149]) {
+    case 0x02: cartRamMask = 0x01fff; break;
+    case 0x03: cartRamMask = 0x07fff; break;
+    case 0x04: cartRamMask = 0x1ffff; break;
+    case 0x05: cartRamMask = 0x0ffff; break;
+    default:
+      printf("Warning: Cartridge header specifies RAM without quantity (0x%02x)\n", cartRom[0x0149]);
+      hasRam = false;
+      break;
+    }
+  }
+  if(hasRam) cartRam = new uint8_t[0x20000];  // maximum RAM size (128KiB)
+
+  // load save file, if present
+  // todo: only load save data if cart has battery
+  savePath = new char[strlen(fname) + 5];
+  sprintf(savePath, "%s.sav", fname);
+  if(hasRam) {
+    FILE* fs = fopen(savePath, "rb");
+    if(fs) {
+      fread(cartRam, sizeof(uint8_t), cartRamMask + 1, fs);
+      fclose(fs);
+    }
+  }
+
+  // load cartridge
+  cart->load(cartRom, cartRomMask, cartRam, cartRamMask);
+  mapCart();
+}
+
+template<class Frontend> uint32_t DMG<Frontend>::loadCartROM(char* fname) {
+  // map the ROM file read-only, so memory is only used for the banks that are read, and is shared between instances
+  // mirroring of banks past the end of the ROM is left to the mapper, which masks bank addresses with the returned mask
+  const uint32_t maxRomSize = 0x800000;  // MBC5 maximum ROM size (8MiB)
+  unloadCartROM();
+  int fd = ::open(fname, O_RDONLY);
+  struct stat fileStat;
+  if(fd < 0 || fstat(fd, &fileStat) < 0) {
+    printf("ERROR: %s is not a valid file path\n", fname);
+    exit(0);
+  }
+  uint32_t fsize = (fileStat.st_size < maxRomSize) ? fileStat.st_size : maxRomSize;
+  uint32_t romMask = 0x7fff;  // at least two banks
+  while(fsize > romMask + 1) romMask = romMask << 1 | 1;
+  cartRomSize = romMask + 1;
+  if(fsize == cartRomSize) {
+    void* mapping = mmap(NULL, cartRomSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(mapping != MAP_FAILED) {
+      cartRom = (uint8_t*)mapping;
+      cartRomMapped = true;
+    }
+  }
+
+  // otherwise, e.g. for an unusually sized ROM, read it into a buffer padded to a power of 2
+  if(!cartRomMapped) {
+    cartRom = new uint8_t[cartRomSize];
+    memset(cartRom, 0xff, cartRomSize);
+    uint32_t offset = 0;
+    while(offset < fsize) {
+      ssize_t count = ::read(fd, cartRom + offset, fsize - offset);
+      if(count <= 0) break;
+      offset += count;
+    }
+  }
+  ::close(fd);
+  return romMask;
+}
+
+template<class Frontend> void DMG<Frontend>::unloadCartROM() {
+  if(!cartRom) return;
+  if(cartRomMapped) {
+    munmap(cartRom, cartRomSize);
+  } else {
+    delete[] cartRom;
+  }
+  cartRom = NULL;
+  cartRomMapped = false;
+}
+
+template<class Frontend> void DMG<Frontend>::save() {
+  // todo: only write save data if cart has battery
+  uint8_t* saveData = cart->getRAM();
+  if(saveData) {
+    FILE* f = fopen(savePath, "wb");
+    fwrite(saveData, sizeof(uint8_t), cart->getSizeRAM(), f);
+    fclose(f);
+  }
+}
+
+template<class Frontend> void DMG<Frontend>::SC(uint8_t data) {
+  sc = data & 0x81;
+  if(sc == 0x81) serialBits = 8;
+  serialSchedule();
+}
+
+template<class Frontend> void DMG<Frontend>::DIV() {
+  // output audio up to now, as the DIV-APU tick that would do it is delayed
+  apuSync();
+  apuEndFrame();
+
+  timerSync();
+  divClock = scheduler.now();
+  serialSchedule();
+  divAPUSchedule();
+  timerSchedule();
+}
+
+template<class Frontend> void DMG<Frontend>::TIMA(uint8_t data) {
+  timerSync();
+  tima = data;
+  timerSchedule();
+}
+
+template<class Frontend> void DMG<Frontend>::TAC(uint8_t data) {
+  timerSync();
+  tac = data & 0x07;
+  timerSchedule();
+}
+
+template<class Frontend> void DMG<Frontend>::DMA(uint8_t data) {
+  dma = data;
+  dmaPending[1] = true;
+  dmaPendingAddr[1] = dma << 8;
+  scheduler.schedule(EVENT_DMA, scheduler.now() + 1);
+}
+
+template<class Frontend> uint8_t DMG<Frontend>::readBus(uint16_t addr) {
+  if(addr < 0x8000) return cart->readROM(addr);
+  if(addr < 0xa000) return vram[addr & 0x1fff];
+  if(addr < 0xc000) return cart->readRAM(addr);
+  return wram[addr & 0x1fff];
+}
+
+template<class Frontend> void DMG<Frontend>::writeBus(uint16_t addr, uint8_t data) {
+  if(addr < 0x8000) { cart->writeROM(addr, data); mapCart(); return; }
+  if(addr < 0xa000) { ppuSync(); ppuFallback(); ppuMarkTile(addr & 0x1fff); vram[addr & 0x1fff] = data; return; }
+  if(addr < 0xc000) return cart->writeRAM(addr, data);
+  wram[addr & 0x1fff] = data;
+  return;
+}
+
+template<class Frontend> void DMG<Frontend>::mapCart() {
+  // stop running the current block, as it may have been mapped out
+  flushBlock();
+
+  // map selected ROM banks, with boot ROM overlaid until disabled
+  for(int i = 0x00; i < 0x80; i++) readMap[i] = cart->romMap[i >> 6] + ((i & 0x3f) << 8);
+  if(!boot) readMap[0x00] = rom;
+
+  // map selected RAM bank, if accessible
+  for(int i = 0xa0; i < 0xc0; i++) {
+    readMap[i] = cart->ramMap ? cart->ramMap + ((i & 0x1f) << 8) : NULL;
+    writeMap[i] = readMap[i];
+  }
+}
+
+template<class Frontend> uint8_t* DMG<Frontend>::codePage(uint16_t addr) {
+  // cache code from ROM and WRAM, as all writes to them go through write8()
+  uint8_t page = addr >> 8;
+  if(page < 0x80 || (page >= 0xc0 && page < 0xfe)) return readMap[page];
+  return NULL;
+}
+
+template<class Frontend> void DMG<Frontend>::protectCode(uint16_t addr) {
+  // track writes to WRAM pages holding cached code, including their echo
+  uint8_t page = addr >> 8;
+  if(page < 0xc0) return;
+  codeMap[page] = true;
+  if((page ^ 0x20) >= 0xc0 && (page ^ 0x20) < 0xfe) codeMap[page ^ 0x20] = true;
+}
+
+template<class Frontend> void DMG<Frontend>::codeWritten(uint16_t addr) {
+  uint8_t page = addr >> 8;
+  flushCode(writeMap[page]);
+  codeMap[page] = false;
+  codeMap[page ^ 0x20] = false;
+}
+
+template<class Frontend> void DMG<Frontend>::mapOAM() {
+  // OAM reads are blocked during OAM DMA
+  // note: writes always go through write8(), which keeps the PPU in sync
+  readMap[0xfe] = dmaActive ? NULL : oam;
+}
+
+template<class Frontend> void DMG<Frontend>::cycleIdle() {
+  cycle();
+}
+
+template<class Frontend> uint8_t DMG<Frontend>::cycleRead(uint16_t addr) {
+  uint8_t data = read8(addr);
+  cycle();
+  return data;
+}
+
+template<class Frontend> void DMG<Frontend>::cycleWrite(uint16_t addr, uint8_t data) {
+  write8(addr, data);
+  cycle();
+}
+
+template<class Frontend> uint8_t DMG<Frontend>::read8(uint16_t addr) {
+  // access plain memory directly
+  uint8_t* page = readMap[addr >> 8];
+  if(page) return page[addr & 0xff];
+
+  if(addr < 0x0100 && !boot) return rom[addr & 0xff];
+  if(addr < 0xfe00) return readBus(addr);
+  if(addr < 0xfea0) return dmaActive ? 0xff : oam[addr & 0xff];
+  if(addr < 0xff00) return 0x00;  // unused part of OAM region
+
+  // I/O region
+  if(addr == 0xff00) return 0xc0 | joyp;  // JOYP
+  if(addr == 0xff01) return sb;  // SB
+  if(addr == 0xff02) return sc | 0x7e;  // SC
+  if(addr == 0xff04) return (uint16_t)(scheduler.now() - divClock) >> 6;  // DIV
+  if(addr == 0xff05) { timerSync(); return tima; }  // TIMA
+  if(addr == 0xff06) return tma;  // TMA
+  if(addr == 0xff07) return 0xf8 | tac;  // TAC
+  if(addr == 0xff0f) return IF();  // IF
+  if(addr >= 0xff10 && addr < 0xff40) return apuReadIO(addr);  // APU I/O
+  if(addr >= 0xff40 && addr < 0xff46) { ppuSync(); return ppuReadIO(addr); }  // PPU I/O
+  if(addr == 0xff46) return dma;  // DMA
+  if(addr >= 0xff47 && addr < 0xff4c) { ppuSync(); return ppuReadIO(addr); }  // PPU I/O
+  if(addr >= 0xff80 && addr < 0xffff) return hram[addr & 0x7f];  // HRAM
+  if(addr == 0xffff) return IE();  // IE
+  return 0xff;
+}
+
+template<class Frontend> void DMG<Frontend>::write8(uint16_t addr, uint8_t data) {
+  // access plain memory directly
+  uint8_t* page = writeMap[addr >> 8];
+  if(page) {
+    page[addr & 0xff] = data;
+    if(codeMap[addr >> 8]) codeWritten(addr);
+    return;
+  }
+
+  if(addr < 0xfe00) return writeBus(addr, data);
+  if(addr < 0xfea0) { if(!dmaActive) { ppuSync(); oam[addr & 0xff] = data; } return; }
+  if(addr < 0xff00) return;  // unused part of OAM region
+
+  // I/O region
+  if(addr == 0xff00) { joyp &= 0xcf; joyp |= data & 0x30; joypadUpdate(); return; }  // JOYP
+  if(addr == 0xff01) { sb = data; return; }  // SB
+  if(addr == 0xff02) { SC(data); return; }  // SC
+  if(addr == 0xff04) { DIV(); return; }  // DIV
+  if(addr == 0xff05) { TIMA(data); return; }  // TIMA
+  if(addr == 0xff06) { tma = data; return; }  // TMA
+  if(addr == 0xff07) { TAC(data); return; }  // TAC
+  if(addr == 0xff0f) { setIF(data); return; }  // IF
+  if(addr >= 0xff10 && addr < 0xff40) { apuSync(); apuWriteIO(addr, data); return; }  // APU I/O
+  if(addr >= 0xff40 && addr < 0xff46) { ppuSync(); ppuWriteIO(addr, data); ppuSchedule(); return; }  // PPU I/O
+  if(addr == 0xff46) { DMA(data); return; }  // DMA
+  if(addr >= 0xff47 && addr < 0xff4c) { ppuSync(); ppuWriteIO(addr, data); ppuSchedule(); return; }  // PPU I/O
+  if(addr == 0xff50) { boot |= (data & 0x01); mapCart(); return; }  // BOOT
+  if(addr >= 0xff80 && addr < 0xffff) { hram[addr & 0x7f] = data; return; }  // HRAM
+  if(addr == 0xffff) { setIE(data); return; }  // IE
+}
+
+template<class Frontend> void DMG<Frontend>::joypadSync() {
+  // JOYP only needs updating when the latched input has changed
+  if(joypadLatch.load(std::memory_order_relaxed) != joypadState) joypadUpdate();
+}
+
+template<class Frontend> void DMG<Frontend>::joypadUpdate() {
+  // determine new JOYP state
+  // todo: is (joyp & 0x30) == 0x00 handled correctly?
+  joypadState = joypadLatch.load(std::memory_order_relaxed);
+  uint8_t data = 0x0f;
+  if(!(joyp & 0x20)) data &= joypadState;
+  if(!(joyp & 0x10)) data &= joypadState >> 4;
+
+  // check for interrupt
+  if((joyp & data) != (joyp & 0x0f)) setIF(IF() | 0x10);
+
+  // update JOYP
+  joyp &= 0xf0;
+  joyp |= data;
+}
+
+template<class Frontend> void DMG<Frontend>::cycleHalt() {
+  // only scheduled events and the joypad can raise an interrupt, so skip ahead to the next event
+  // note: DIV-APU is always scheduled, so a change to the joypad latch is seen within 2048 cycles
+  scheduler.skip(scheduler.next() - scheduler.now());
+  runEvents();
+  joypadSync();
+}
+
+template<class Frontend> void DMG<Frontend>::cycle() {
+  // run 1 M-cycle
+  scheduler.tick();
+  if(scheduler.due()) runEvents();
+  joypadSync();
+}
+
+template<class Frontend> void DMG<Frontend>::runEvents() {
+  for(int event = scheduler.pop(); event >= 0; event = scheduler.pop()) {
+    switch(event) {
+    case EVENT_PPU: ppuSync(); ppuSchedule(); break;
+    case EVENT_SERIAL: serialEvent(); break;
+    case EVENT_DMA: dmaEvent(); break;
+    case EVENT_DIV_APU: divAPUEvent(); break;
+    case EVENT_TIMER: timerSync(); timerSchedule(); break;
+    }
+  }
+}
+
+template<class Frontend> void DMG<Frontend>::ppuSync() {
+  // catch PPU up to the current cycle
+  uint64_t now = scheduler.now();
+  ppuRun((now - ppuClock) << 2);  // 4 dots per M-cycle
+  ppuClock = now;
+}
+
+template<class Frontend> void DMG<Frontend>::ppuSchedule() {
+  int dots = ppuNextDots();
+  if(dots < 0) return scheduler.cancel(EVENT_PPU);
+  scheduler.schedule(EVENT_PPU, ppuClock + ((dots + 3) >> 2));
+}
+
+template<class Frontend> void DMG<Frontend>::serialEvent() {
+  sb <<= 1;
+  sb |= 0x01;  // if serial port is disconnected, always read 1
+  serialBits--;
+  if(!serialBits) {
+    sc &= 0x7f;
+    setIF(IF() | 0x08);
+  }
+  serialSchedule();
+}
+
+template<class Frontend> void DMG<Frontend>::serialSchedule() {
+  // serial port is clocked on cycles that start with the low 7 bits of DIV clear
+  if(!serialBits || sc != 0x81) return scheduler.cancel(EVENT_SERIAL);
+  uint64_t now = scheduler.now();
+  uint64_t start = now + ((0x80 - ((now - divClock) & 0x7f)) & 0x7f);
+  scheduler.schedule(EVENT_SERIAL, start + 1);
+}
+
+template<class Frontend> void DMG<Frontend>::dmaEvent() {
+  // run 1 byte of DMA transfer, if active
+  if(dmaActive) {
+    ppuSync();
+    oam[dmaAddr & 0xff] = readBus(dmaAddr);
+    dmaAddr++;
+    if((dmaAddr & 0xff) >= 0xa0) dmaActive = false;
+  }
+
+  // start DMA, if pending
+  if(dmaPending[0]) {
+    dmaActive = true;
+    dmaAddr = dmaPendingAddr[0];
+  }
+  mapOAM();
+  dmaPendingAddr[0] = dmaPendingAddr[1];
+  dmaPending[0] = dmaPending[1];
+  dmaPending[1] = false;
+
+  if(dmaActive || dmaPending[0]) scheduler.schedule(EVENT_DMA, scheduler.now() + 1);
+}
+
+template<class Frontend> void DMG<Frontend>::apuSync() {
+  // catch APU up to the current cycle
+  // note: the APU only changes state visible to the CPU on register writes and DIV-APU ticks
+  uint64_t now = scheduler.now();
+  apuRun(now - apuClock);
+  apuClock = now;
+}
+
+template<class Frontend> void DMG<Frontend>::divAPUEvent() {
+  apuSync();
+  divAPU();
+  divAPUSchedule();
+}
+
+template<class Frontend> void DMG<Frontend>::divAPUSchedule() {
+  // DIV-APU is clocked on the falling edge of DIV bit 4
+  uint64_t elapsed = scheduler.now() - divClock;
+  scheduler.schedule(EVENT_DIV_APU, divClock + (elapsed | 0x7ff) + 1);
+}
+
+template<class Frontend> bool DMG<Frontend>::timerSignal(uint64_t time) {
+  // find state of timer clocking signal on the given cycle
+  uint16_t div = time - divClock;
+  switch(tac & 0x07) {
+  case 0x04: return div & 0x80;
+  case 0x05: return div & 0x02;
+  case 0x06: return div & 0x08;
+  case 0x07: return div & 0x20;
+  }
+  return false;
+}
+
+template<class Frontend> uint64_t DMG<Frontend>::timerPeriod() {
+  // number of cycles between falling edges of the timer clocking signal
+  switch(tac & 0x03) {
+  case 0x00: return 0x100;
+  case 0x01: return 0x04;
+  case 0x02: return 0x10;
+  case 0x03: return 0x40;
+  }
+  return 0x100;
+}
+
+template<class Frontend> void DMG<Frontend>::timerSync() {
+  // catch TIMA up to the current cycle
+  uint64_t now = scheduler.now();
+  if(timerClock == now) return;
+
+  // the first cycle uses the stored clocking signal, as DIV or TAC may have changed since
+  uint32_t ticks = 0;
+  if(clkTimer && !timerSignal(timerClock + 1)) ticks++;
+
+  // timer is clocked on every falling edge after that
+  if(tac & 0x04) {
+    uint64_t period = timerPeriod();
+    ticks += (now - divClock) / period - (timerClock + 1 - divClock) / period;
+  }
+  clkTimer = timerSignal(now);
+  timerClock = now;
+
+  // apply ticks, reloading TIMA on overflow
+  while(tima + ticks > 0xff) {
+    ticks -= 0x100 - tima;
+    tima = tma;
+    setIF(IF() | 0x04);
+  }
+  tima += ticks;
+}
+
+template<class Frontend> void DMG<Frontend>::timerSchedule() {
+  // find the cycle on which TIMA next overflows
+  uint64_t next = scheduler.now() + 1;
+  uint32_t ticks = 0x100 - tima;
+  if(clkTimer && !timerSignal(next)) ticks--;
+  if(!ticks) return scheduler.schedule(EVENT_TIMER, next);
+  if(!(tac & 0x04)) return scheduler.cancel(EVENT_TIMER);
+  uint64_t period = timerPeriod();
+  uint64_t edge = next + period - ((next - divClock) % period);
+  scheduler.schedule(EVENT_TIMER, edge + (ticks - 1) * period);
+}
@@ -0,0 +1,35 @@
+#include <cstdint>
+
+// pixel formats that lines of shades can be converted to
+enum {
+  FORMAT_RGBA32,  // 32 bits per pixel, as 0xAABBGGRR
+  FORMAT_RGB565,  // 16 bits per pixel
+  FORMAT_GREY8,  // 8 bits per pixel
+  FORMAT_COUNT
+};
+
+// converts lines of 160 shades (0-3) from the PPU into pixels, 8-32 at a time with AVX2 or SSE2 if enabled
+class Palette {
+public:
+  Palette() {
+    static const uint32_t dmgColours[4] = {0xffffffff, 0xffaaaaaa, 0xff555555, 0xff000000};
+    format = -1;
+    for(int i = 0; i < 4; i++) colours[i] = 0;
+    setPalette(FORMAT_RGBA32, dmgColours);
+  }
+
+  // set the output format and the colour of each shade (as 0xAABBGGRR), only rebuilding the LUT if they change
+  void setPalette(int pixelFormat, const uint32_t shadeColours[4]);
+  void convertLine(const uint8_t* line, void* out);
+  int bytesPerPixel() { return (format == FORMAT_RGBA32) ? 4 : (format == FORMAT_RGB565) ? 2 : 1; }
+
+private:
+  void buildLUT();
+  void convertRGBA32(const uint8_t* line, uint32_t* out);
+  void convertRGB565(const uint8_t* line, uint16_t* out);
+  void convertGrey8(const uint8_t* line, uint8_t* out);
+
+  int format;
+  uint32_t colours[4];
+  uint32_t lut[4];  // pixel of each shade in the output format
+};
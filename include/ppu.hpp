@@ -1,15 +1,30 @@
 #include <cstdint>
+#include <cstring>
 
-class PPU {
+// which frames the PPU draws, without changing its timing
+enum {
+  RENDER_ALL,
+  RENDER_INTERVAL,  // every Nth frame
+  RENDER_REQUESTED,  // frames after a call to requestFrame()
+  RENDER_NEVER
+};
+
+// Sink is the class deriving from PPU<Sink>, which receives interrupts, pixels and frames
+template<class Sink> class PPU {
 public:
   PPU() {
     vram = new uint8_t[0x2000];
-    oam = new uint8_t[0xa0];
+    oam = new uint8_t[0x100]();  // includes unused area at 0xfea0-0xfeff, which reads as 0x00
+    tileData = new uint8_t[384 * 128];
+    for(int i = 0; i < 48; i++) tileDirty[i] = 0xff;  // decode all tiles on first use
 
     // initialize PPU state
     lcdc = 0x00;
     stat = 0x00;
     scx = 0x00;
+    bgp = 0x00;
+    obp0 = 0x00;
+    obp1 = 0x00;
     ly = 0x00;
     lyc = 0x00;
     wy = 0x00;
@@ -17,33 +32,85 @@ public:
     scanCycle = 0;
     irqSTAT = false;
     bgStep = 0;
+    spriteCount = 0;
+    memset(objBuffer, 0x00, sizeof(objBuffer));
+    buildPaletteLUT();
+    dirty = false;
+    fastLine = false;
+    frameBuffer = NULL;
+    line = lineBuffer;
+    lineRenderer = true;
+    renderMode = RENDER_ALL;
+    renderInterval = 1;
+    renderCount = 0;
+    renderRequested = false;
+    renderFrame = true;
+    fastLines = 0;
+    slowLines = 0;
   }
 
   ~PPU() {
     delete[] vram;
     delete[] oam;
+    delete[] tileData;
   }
 
   uint8_t ppuReadIO(uint16_t addr);
   void ppuWriteIO(uint16_t addr, uint8_t data);
   void ppuTick();
+  void ppuRun(uint64_t dots);
+  int ppuNextDots();
+  void ppuFallback();
+  void ppuMarkTile(uint16_t addr) { if(addr < 0x1800) tileDirty[addr >> 7] |= 1 << ((addr >> 4) & 0x07); }
+
+  // choose which frames to draw from the next frame on, e.g. from frame() to fast-forward
+  void setRenderMode(int mode, int interval = 1) { renderMode = mode; renderInterval = (interval > 0) ? interval : 1; }
+  void requestFrame() { renderRequested = true; }
+  bool frameDrawn() { return renderFrame; }  // current frame (or, from frame(), the one just finished) is drawn
+
+  // draw lines straight into a 160x144 buffer of shades, e.g. one set from frame() for the next frame (or NULL)
+  void setFrameBuffer(uint8_t* buffer) { frameBuffer = buffer; }
+
+  // row of one of the 384 tiles in VRAM, as 8 palette indices from left to right (or right to left if flipped)
+  const uint8_t* tileRow(uint16_t tile, uint8_t fineY, bool flip);
 
-  virtual void irqRaiseVBLANK() { return; }
-  virtual void irqRaiseSTAT() { return; }
-  virtual void frame() { return; }
-  virtual void plotPixel(int x, int y, uint8_t data) { return; }
+  // sink callbacks, hidden by the Sink class
+  void irqRaiseVBLANK() { return; }
+  void irqRaiseSTAT() { return; }
+  void frame() { return; }
+  void plotPixel(int x, int y, uint8_t data) { return; }
+  // line of 160 shades (0-3), called once mode 3 of the line is over
+  void plotLine(int y, const uint8_t* data) { for(int x = 0; x < 160; x++) sink()->plotPixel(x, y, data[x]); }
 
   // PPU memory
   uint8_t* vram;
   uint8_t* oam;
 
+  // render whole scanlines at once, unless VRAM or registers change during mode 3
+  bool lineRenderer;
+
+  // scanlines drawn by the whole-line and dot-by-dot renderers so far this frame
+  int fastLines;
+  int slowLines;
+
 private:
+  Sink* sink() { return static_cast<Sink*>(this); }
+
+  int ppuIdleDots();
+  void ppuStartFrame();
   uint8_t STAT();
   void oamScan();
   uint8_t bgReadTilemap(uint8_t x);
   uint8_t bgGetTileData(uint8_t tile, uint8_t bitLoHi);
+  const uint8_t* bgGetTileRow(uint8_t tile);
+  void decodeTile(uint16_t tile);
+  void bgResetFIFO();
   void bgTickFIFO();
+  void renderDot();
+  void renderLine();
   void renderSprites();
+  uint8_t mixPixel(int x, uint8_t bgPalette);
+  void buildPaletteLUT();
 
   // PPU registers
   uint8_t lcdc;
@@ -68,8 +135,9 @@ private:
   uint8_t bgStep;
   bool bgIsWin;
 
-  // OAM buffer
+  // OAM buffer, sorted by X
   uint8_t spriteBuffer[40];
+  uint8_t spriteCount;
 
   // PPU internal state
   int scanCycle;
@@ -78,9 +146,29 @@ private:
   uint8_t lx;
   int xOut;
   bool rendering;
+  bool dirty;  // registers were written since the last dot was run
 
   // Scanline renderer state
-  uint8_t objBuffer[160];
-  uint8_t attrBuffer[160];
+  // sprite pixels of the current line from X = 0 (8 pixels left of the screen), as palette index | OBP1 << 2 | BG priority << 3
+  uint8_t objBuffer[8 + 160 + 8];
+  bool fastLine;  // current line was drawn by renderLine()
+  int lineEnd;  // dot on which mode 3 of the current line ends
+  uint8_t lineWinCount;  // window line counter before the current line
+  uint8_t lineBuffer[160];  // shades of the current line, if there is no frame buffer
+  uint8_t* frameBuffer;
+  uint8_t* line;  // where the current line is drawn
+  uint8_t paletteLUT[64];  // shade of each sprite buffer entry (shifted left 2) and BG palette index
+
+  // Frame skipping state
+  int renderMode;
+  int renderInterval;
+  int renderCount;  // frames since the last one drawn in RENDER_INTERVAL mode
+  bool renderRequested;
+  bool renderFrame;  // current frame is drawn
+
+  // Tile cache
+  uint8_t* tileData;  // 8x8 palette indices of each tile, followed by the same tile flipped horizontally
+  uint8_t tileDirty[48];  // bitmap of tiles written since they were last decoded
 };
 
+#include "ppu.tpp"
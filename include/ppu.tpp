@@ -0,0 +1,398 @@
+template<class Sink> uint8_t PPU<Sink>::ppuReadIO(uint16_t addr) {
+  switch(addr) {
+  case 0xff40: return lcdc;  // LCDC
+  case 0xff41: return STAT();  // STAT
+  case 0xff42: return scy;  // SCY
+  case 0xff43: return scx;  // SCX
+  case 0xff44: return ly;  // LY
+  case 0xff45: return lyc;  // LYC
+  case 0xff47: return bgp;  // BGP
+  case 0xff48: return obp0;  // OBP0
+  case 0xff49: return obp1;  // OBP1
+  case 0xff4a: return wy;  // WY
+  case 0xff4b: return wx;  // WX
+  }
+  return 0xff;
+}
+
+template<class Sink> void PPU<Sink>::ppuWriteIO(uint16_t addr, uint8_t data) {
+  dirty = true;
+  if(addr != 0xff41 && addr != 0xff45) ppuFallback();
+  switch(addr) {
+  case 0xff40: lcdc = data; return;  // LCDC
+  case 0xff41: stat = data & 0x78; return;  // STAT
+  case 0xff42: scy = data; return;  // SCY
+  case 0xff43: scx = data; return;  // SCX
+  case 0xff45: lyc = data; return;  // LYC
+  case 0xff47: bgp = data; buildPaletteLUT(); return;  // BGP
+  case 0xff48: obp0 = data; buildPaletteLUT(); return;  // OBP0
+  case 0xff49: obp1 = data; buildPaletteLUT(); return;  // OBP1
+  case 0xff4a: wy = data; return;  // WY
+  case 0xff4b: wx = data; return;  // WX
+  }
+}
+
+template<class Sink> void PPU<Sink>::ppuTick() {
+  // run PPU if LCD is enabled
+  if(!(lcdc & 0x80)) return;
+  scanCycle++;
+  dirty = false;
+
+  if(ly < 144 && scanCycle == 80) {
+    // enter mode 3
+    rendering = true;
+    bgResetFIFO();
+    line = frameBuffer ? &frameBuffer[160 * ly] : lineBuffer;
+
+    // run sprite scanline renderer
+    if(renderFrame) {
+      oamScan();
+      if(lcdc & 0x02) renderSprites();
+    }
+
+    // draw the whole line now, if enabled
+    if(lineRenderer) renderLine();
+  }
+
+  if(ly < 144 && rendering && fastLine) {
+    // output line drawn by renderLine() once mode 3 is over
+    if(scanCycle == lineEnd) {
+      if(renderFrame) sink()->plotLine(ly, line);
+      rendering = false;
+    }
+  } else if(ly < 144 && scanCycle >= 86 && rendering) {
+    // todo: include the PPU activity from cycle 80-85
+    renderDot();
+  }
+
+  if(scanCycle == 456) {
+    if(ly < 144) fastLine ? fastLines++ : slowLines++;
+    fastLine = false;
+    memset(objBuffer, 0x00, sizeof(objBuffer));  // clear sprite buffer
+    scanCycle = 0;
+    ly++;
+    if(ly == 154) {
+      ly = 0;
+      yWinCount = 0xff;
+      sink()->frame();
+      fastLines = 0;
+      slowLines = 0;
+      ppuStartFrame();
+    }
+    if(ly == 144) sink()->irqRaiseVBLANK();
+  }
+
+  bool irqPrevSTAT = irqSTAT;
+  irqSTAT = false;
+  if((stat & 0x40) && ly == lyc                                 ) irqSTAT = true;  // LYC
+  if((stat & 0x20) && ly <= 144 && scanCycle <  80              ) irqSTAT = true;  // mode 2
+  if((stat & 0x10) && ly >= 144                                 ) irqSTAT = true;  // mode 1
+  if((stat & 0x08) && ly <  144 && scanCycle >= 80 && !rendering) irqSTAT = true;  // mode 0
+  if(irqSTAT && !irqPrevSTAT) sink()->irqRaiseSTAT();
+}
+
+template<class Sink> void PPU<Sink>::ppuRun(uint64_t dots) {
+  // run PPU if LCD is enabled
+  if(!(lcdc & 0x80)) return;
+
+  while(dots) {
+    // skip over dots that only advance the scanline position
+    uint64_t idle = ppuIdleDots();
+    if(idle) {
+      if(idle > dots) idle = dots;
+      scanCycle += idle;
+      dots -= idle;
+      continue;
+    }
+    ppuTick();
+    dots--;
+  }
+}
+
+template<class Sink> int PPU<Sink>::ppuNextDots() {
+  // number of dots until the PPU may next raise an interrupt or finish a frame, or -1 if LCD is disabled
+  // note: anything else it does is only observed through accesses that run it first
+  if(!(lcdc & 0x80)) return -1;
+
+  // registers were just written, which may change the STAT interrupt line
+  if(dirty) return 1;
+
+  // end of mode 3 on the current line
+  if((stat & 0x08) && ly < 144) {
+    if(scanCycle < 80) return 80 - scanCycle;  // mode 3 end is known once it starts
+    if(rendering && fastLine) return lineEnd - scanCycle;
+    if(rendering) return (scanCycle < 245) ? 245 - scanCycle : 1;  // earliest possible end
+  }
+
+  // start of the following lines, up to the end of the frame
+  int dots = 456 - scanCycle;
+  for(int line = ly + 1; line < 154; line++, dots += 456) {
+    if(line == 144) return dots;  // VBLANK
+    if((stat & 0x40) && line == lyc) return dots;  // LYC
+    if((stat & 0x20) && line <= 144) return dots;  // mode 2
+    if((stat & 0x10) && line >= 144) return dots;  // mode 1
+    if((stat & 0x08) && line < 144) return dots + 80;  // mode 0, from the start of mode 3
+  }
+  return dots;
+}
+
+template<class Sink> int PPU<Sink>::ppuIdleDots() {
+  // count upcoming dots on which nothing happens, and the STAT interrupt line cannot change
+  if(dirty) return 0;
+  if(ly < 144 && rendering && !fastLine && scanCycle >= 85) return 0;
+  int next = 456;
+  if(scanCycle < 80) {
+    next = 80;
+  } else if(ly < 144 && rendering) {
+    next = fastLine ? lineEnd : 86;
+  }
+  return next - scanCycle - 1;
+}
+
+template<class Sink> void PPU<Sink>::ppuStartFrame() {
+  // decide whether to draw the next frame, which only skips pixel output, not timing
+  switch(renderMode) {
+  case RENDER_ALL: renderFrame = true; return;
+  case RENDER_INTERVAL: renderFrame = !renderCount; renderCount = (renderCount + 1) % renderInterval; return;
+  case RENDER_REQUESTED: renderFrame = renderRequested; renderRequested = false; return;
+  case RENDER_NEVER: renderFrame = false; return;
+  }
+}
+
+template<class Sink> void PPU<Sink>::ppuFallback() {
+  // called before a write that may change how the rest of the current line is drawn
+  if(!fastLine || !rendering) return;
+
+  // rerun mode 3 up to the current dot with the dot-by-dot renderer, which draws the rest of the line
+  fastLine = false;
+  yWinCount = lineWinCount;
+  bgResetFIFO();
+  for(int dot = 86; dot <= scanCycle; dot++) renderDot();
+}
+
+template<class Sink> uint8_t PPU<Sink>::STAT() {
+  // todo: is bit 7 handled correctly?
+  uint8_t data = 0x80 | stat;
+  if(ly == lyc) data |= 0x04;
+  if(ly >= 144) {
+    data |= 0x01;
+  } else if(scanCycle < 80) {
+    data |= 0x02;
+  } else if(scanCycle < 252) {
+    // todo: HBLANK start time can vary
+    data |= 0x03;
+  }
+  return data;
+}
+
+template<class Sink> void PPU<Sink>::oamScan() {
+  // calculate sprite height
+  uint8_t spriteHeight = (lcdc & 0x04) ? 16 : 8;
+
+  // perform OAM scan, keeping the buffer sorted by X (then OAM order) as sprites are found
+  spriteCount = 0;
+  for(int i = 0; i < 160; i += 4) {
+    uint8_t dataY = ly + 16 - oam[i + 0];
+    if(dataY >= spriteHeight) continue;
+    int pos = spriteCount << 2;
+    while(pos && spriteBuffer[pos - 4 + 1] > oam[i + 1]) {
+      memcpy(&spriteBuffer[pos], &spriteBuffer[pos - 4], 4);
+      pos -= 4;
+    }
+    memcpy(&spriteBuffer[pos], &oam[i], 4);
+    if(++spriteCount == 10) break;
+  }
+}
+
+template<class Sink> uint8_t PPU<Sink>::bgReadTilemap(uint8_t x) {
+  uint8_t tileY = bgIsWin ? (yWinCount >> 3) : ((uint8_t)(ly + scy) >> 3);
+  uint8_t tileX = bgIsWin ? (x >> 3) : ((uint8_t)(x + scx) >> 3);
+  uint16_t baseAddr = (bgIsWin ? (lcdc & 0x40) : (lcdc & 0x08)) ? 0x1c00 : 0x1800;
+  return vram[baseAddr | tileY << 5 | tileX];
+}
+
+template<class Sink> uint8_t PPU<Sink>::bgGetTileData(uint8_t tile, uint8_t bitLoHi) {
+  uint8_t fineY = bgIsWin ? (yWinCount & 0x07) : (ly + scy) & 0x07;
+  uint16_t baseAddr = (!(lcdc & 0x10) && !(tile & 0x80)) ? 0x1000 : 0x0000;
+  return vram[baseAddr | tile << 4 | fineY << 1 | bitLoHi];
+}
+
+template<class Sink> const uint8_t* PPU<Sink>::bgGetTileRow(uint8_t tile) {
+  uint8_t fineY = bgIsWin ? (yWinCount & 0x07) : (ly + scy) & 0x07;
+  uint16_t index = (!(lcdc & 0x10) && !(tile & 0x80)) ? 0x100 | tile : tile;
+  return tileRow(index, fineY, false);
+}
+
+template<class Sink> const uint8_t* PPU<Sink>::tileRow(uint16_t tile, uint8_t fineY, bool flip) {
+  if(tileDirty[tile >> 3] & (1 << (tile & 0x07))) decodeTile(tile);
+  return &tileData[tile << 7 | flip << 6 | fineY << 3];
+}
+
+template<class Sink> void PPU<Sink>::decodeTile(uint16_t tile) {
+  tileDirty[tile >> 3] &= ~(1 << (tile & 0x07));
+  uint8_t* data = &vram[tile << 4];
+  uint8_t* out = &tileData[tile << 7];
+  for(int y = 0; y < 8; y++) {
+    uint8_t lo = data[y << 1 | 0];
+    uint8_t hi = data[y << 1 | 1];
+    for(int x = 0; x < 8; x++) {
+      uint8_t palette = ((hi >> (7 - x)) & 1) << 1 | ((lo >> (7 - x)) & 1);
+      out[0x00 | y << 3 | x] = palette;
+      out[0x40 | y << 3 | (7 - x)] = palette;
+    }
+  }
+}
+
+template<class Sink> void PPU<Sink>::bgResetFIFO() {
+  xOut = 0 - (scx & 0x07);
+  lx = 0;
+  bgFifoSize = 0;
+  bgStep = 0;
+  bgIsWin = false;
+}
+
+template<class Sink> void PPU<Sink>::bgTickFIFO() {
+  if(!(lcdc & 0x01)) {
+    // emit blank pixels if background is disabled
+    bgFifoSize = 8;
+    bgFifoLo = 0x00;
+    bgFifoHi = 0x00;
+    return;
+  }
+
+  switch(bgStep) {
+  case 0: bgStep++;                                      break;
+  case 1: bgStep++; if(renderFrame) bgTile   = bgReadTilemap(lx);        break;
+  case 2: bgStep++;                                                      break;
+  case 3: bgStep++; if(renderFrame) bgDataLo = bgGetTileData(bgTile, 0); break;
+  case 4: bgStep++;                                                      break;
+  case 5: bgStep++; if(renderFrame) bgDataHi = bgGetTileData(bgTile, 1); break;
+  case 6:
+    // insert data into FIFO, if possible
+    if(!bgFifoSize) {
+      bgFifoSize = 8;
+      bgFifoLo = bgDataLo;
+      bgFifoHi = bgDataHi;
+      lx += 8;
+      bgStep = 0;
+      if(!(lcdc & 0x20)) bgIsWin = false;
+    }
+    break;
+  }
+}
+
+template<class Sink> void PPU<Sink>::renderDot() {
+  // start window, if reached
+  // todo: this should actually occur after shifting out 1 pixel
+  if(!bgIsWin && (lcdc & 0x20) && ly >= wy && (xOut + 7) == wx) {
+    lx = 0;
+    bgFifoSize = 0;
+    bgStep = 0;
+    bgIsWin = true;
+    yWinCount++;
+  }
+
+  // generate pixels
+  bgTickFIFO();
+
+  //output pixels if ready
+  if(bgFifoSize && xOut < 160) {
+    uint8_t bgPalette = (bgFifoHi >> 7) << 1 | (bgFifoLo >> 7);
+    bgFifoHi <<= 1;
+    bgFifoLo <<= 1;
+    bgFifoSize--;
+
+    // output pixel if onscreen, and the line once complete
+    if(xOut >= 0 && renderFrame) line[xOut] = mixPixel(xOut, bgPalette);
+    xOut++;
+    if(xOut == 160) {
+      rendering = false;
+      if(renderFrame) sink()->plotLine(ly, line);
+    }
+  }
+}
+
+template<class Sink> void PPU<Sink>::renderLine() {
+  // draw the line as renderDot() would if nothing changes during mode 3, 8 pixels per tile fetch
+  int fineX = scx & 0x07;
+  fastLine = true;
+  lineWinCount = yWinCount;
+
+  // find the pixel (counting those scrolled off the left edge) on which the window starts, if reached
+  int winStart = 160 + fineX;
+  if((lcdc & 0x20) && ly >= wy && wx - 7 + fineX >= 0 && wx - 7 < 160) {
+    winStart = wx - 7 + fineX;
+    yWinCount++;
+  }
+
+  // find when the last pixel is output, as the fetcher first needs 6 dots when BG is enabled, and 6 more to start the window
+  lineEnd = 86 + 159 + fineX;
+  if(lcdc & 0x01) lineEnd += (winStart > 0 && winStart < 160 + fineX) ? 12 : 6;
+
+  // skip drawing if the frame is not output
+  if(!renderFrame) return;
+
+  const uint8_t* row = NULL;
+  for(int i = 0; i < 160 + fineX; i++) {
+    // fetch next BG or window tile, unless BG is disabled
+    bool win = i >= winStart;
+    uint8_t fetchX = win ? i - winStart : i;
+    if(!(fetchX & 0x07) && (lcdc & 0x01)) {
+      bgIsWin = win;
+      lx = fetchX;
+      bgTile = bgReadTilemap(lx);
+      row = bgGetTileRow(bgTile);
+    }
+
+    // output pixel if onscreen
+    uint8_t bgPalette = (lcdc & 0x01) ? row[fetchX & 0x07] : 0;
+    if(i >= fineX) line[i - fineX] = mixPixel(i - fineX, bgPalette);
+  }
+}
+
+template<class Sink> uint8_t PPU<Sink>::mixPixel(int x, uint8_t bgPalette) {
+  return paletteLUT[objBuffer[x + 8] << 2 | bgPalette];
+}
+
+template<class Sink> void PPU<Sink>::buildPaletteLUT() {
+  // shade of each combination of BG palette index, sprite palette index, OBP1 select and BG priority
+  for(int i = 0; i < 64; i++) {
+    uint8_t bgPalette = i & 0x03;
+    uint8_t objPalette = (i >> 2) & 0x03;
+    uint8_t bgColour = (bgp >> (bgPalette << 1)) & 0x03;
+    uint8_t objColour = (((i & 0x10) ? obp1 : obp0) >> (objPalette << 1)) & 0x03;
+    paletteLUT[i] = (objPalette && (!bgPalette || !(i & 0x20))) ? objColour : bgColour;
+  }
+}
+
+template<class Sink> void PPU<Sink>::renderSprites() {
+  // calculate sprite height
+  uint8_t spriteHeight = (lcdc & 0x04) ? 16 : 8;
+
+  // draw sprites in priority order, each only onto pixels not already covered by a sprite
+  for(int i = 0; i < (spriteCount << 2); i += 4) {
+    // skip sprites that are entirely offscreen to the right
+    uint8_t dataX = spriteBuffer[i + 1];
+    if(dataX >= 168) continue;
+
+    // fetch tile data
+    uint8_t dataY = ly + 16 - spriteBuffer[i + 0];
+    uint8_t tile = spriteBuffer[i + 2];
+    uint8_t attributes = spriteBuffer[i + 3];
+    uint8_t fineY = dataY & (spriteHeight - 1);
+    if(attributes & 0x40) fineY ^= (spriteHeight - 1);
+    if(lcdc & 0x04) tile &= ~1;  // mask low bit of tile ID for 8x16 sprites
+    const uint8_t* row = tileRow(tile + (fineY >> 3), fineY & 0x07, attributes & 0x20);
+
+    // merge all 8 pixels at once, as the buffers are padded by 8 pixels on each side
+    uint64_t palette, objPalette;
+    memcpy(&palette, row, 8);
+    memcpy(&objPalette, &objBuffer[dataX], 8);
+    uint64_t opaque = ((palette | palette >> 1) & 0x0101010101010101) * 0xff;
+    uint64_t covered = ((objPalette | objPalette >> 1) & 0x0101010101010101) * 0xff;
+    uint64_t mask = opaque & ~covered;
+    uint8_t attrBits = (attributes & 0x10) >> 2 | (attributes & 0x80) >> 4;  // OBP1, BG priority
+    objPalette |= (palette | attrBits * 0x0101010101010101) & mask;
+    memcpy(&objBuffer[dataX], &objPalette, 8);
+  }
+}
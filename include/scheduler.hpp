@@ -0,0 +1,41 @@
+#include <cstdint>
+
+// timed events, in the order they run when due on the same cycle
+enum {
+  EVENT_PPU,
+  EVENT_SERIAL,
+  EVENT_DMA,
+  EVENT_DIV_APU,
+  EVENT_TIMER,
+  EVENT_COUNT
+};
+
+class Scheduler {
+public:
+  static constexpr uint64_t NEVER = UINT64_MAX;
+
+  Scheduler() {
+    clock = 0;
+    for(int i = 0; i < EVENT_COUNT; i++) eventTime[i] = NEVER;
+    nextTime = NEVER;
+  }
+
+  uint64_t now() { return clock; }
+  uint64_t next() { return nextTime; }
+  void tick() { clock++; }
+  void skip(uint64_t cycles) { clock += cycles; }
+  bool due() { return clock >= nextTime; }
+  void schedule(int event, uint64_t time);
+  void cancel(int event) { schedule(event, NEVER); }
+  int pop();
+
+private:
+  void findNext();
+
+  // global M-cycle counter
+  uint64_t clock;
+
+  // cycle on which each event fires
+  uint64_t eventTime[EVENT_COUNT];
+  uint64_t nextTime;
+};
@@ -1,23 +1,90 @@
+#include <cstddef>
 #include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
-class SM83 {
+// Bus is the class deriving from SM83<Bus>, whose callbacks are called without virtual dispatch
+template<class Bus> class SM83 {
 public:
+  SM83() {
+    flagOp = FLAGS_F;
+    blockCache = true;
+    block = NULL;
+  }
+
+  ~SM83() {
+    for(auto& page : codeCache) freeCodePage(page.second);
+  }
+
   void reset();
   void instruction();
   void setIF(uint8_t data) { _if = data & 0x1f; }
   void setIE(uint8_t data) { _ie = data; }
   uint8_t IF() { return 0xe0 | _if; }
   uint8_t IE() { return _ie; }
-  virtual void cycleIdle() { return; }
-  virtual uint8_t cycleRead(uint16_t addr) { return 0xff; }
-  virtual void cycleWrite(uint16_t addr, uint8_t data) { return; }
+  // bus callbacks, hidden by the Bus class to connect the CPU to memory
+  void cycleIdle() { return; }
+  void cycleHalt() { bus()->cycleIdle(); }
+  uint8_t cycleRead(uint16_t addr) { return 0xff; }
+  void cycleWrite(uint16_t addr, uint8_t data) { return; }
+
+  // memory containing cacheable code, as a pointer to the 256-byte page holding addr (or NULL)
+  uint8_t* codePage(uint16_t addr) { return NULL; }
+  // called when code is first cached from the page holding addr, so writes to it can be tracked
+  void protectCode(uint16_t addr) { return; }
+
+  // run pre-decoded blocks of instructions, instead of fetching and decoding each instruction
+  bool blockCache;
+
+protected:
+  void flushCode(uint8_t* page);
+  void flushBlock() { block = NULL; }
 
 private:
+  Bus* bus() { return static_cast<Bus*>(this); }
+
+  typedef void (SM83::*Handler)();
+
+  // handlers for each opcode, generated at compile time
+  struct HandlerTable {
+    Handler handlers[0x100];
+  };
+
+  // pre-decoded instruction
+  struct Op {
+    uint8_t bytes[3];  // opcode and immediate operands
+    uint8_t length;
+    Handler handler;
+  };
+
+  // sequence of instructions that run in order, ending at a jump or page boundary
+  struct Block {
+    std::vector<Op> ops;
+  };
+
+  // blocks cached from one 256-byte page, indexed by start address
+  struct CodePage {
+    Block* blocks[0x100];
+  };
+
+  bool nextOp();
+  Block* findBlock(uint16_t addr);
+  Block* decodeBlock(uint8_t* page, uint8_t index);
+  uint8_t opLength(uint8_t opcode);
+  bool opEndsBlock(uint8_t opcode);
+  void freeCodePage(CodePage* page);
+
+  template<uint8_t opcode> void instructionOp();
+  template<uint8_t opcode> void instructionOpCB();
+  template<std::size_t... opcodes> static constexpr HandlerTable buildTable(std::index_sequence<opcodes...>);
+  template<std::size_t... opcodes> static constexpr HandlerTable buildTableCB(std::index_sequence<opcodes...>);
+  static const HandlerTable opTable;
+  static const HandlerTable cbTable;
+
   void instructionCB();
-  uint8_t regSrcRead();
-  uint8_t regDstRead();
-  void regSrcWrite(uint8_t data);
-  void regDstWrite(uint8_t data);
+  template<uint8_t index> uint8_t regRead();
+  template<uint8_t index> void regWrite(uint8_t data);
   void runISR(uint16_t addr);
   void write16(uint16_t addr, uint16_t data);
   uint8_t fetch8();
@@ -31,6 +98,11 @@ private:
   uint16_t incHL();
   uint16_t decHL();
   uint16_t addSP();
+  uint8_t F();
+  void setF(uint8_t data);
+  void setFlags(bool z, bool n, bool h, bool c);
+  void lazyFlags(uint8_t op, uint8_t x, uint8_t y, uint16_t result) { flagOp = op; flagX = x; flagY = y; flagResult = result; }
+  void syncFlags();
   void setZ(bool cond);
   void setN(bool cond);
   void setH(bool cond);
@@ -40,8 +112,8 @@ private:
   bool HF();
   bool CF();
 
-  void INC();
-  void DEC();
+  template<uint8_t index> void INC();
+  template<uint8_t index> void DEC();
   void RLCA();
   void RRCA();
   void RLA();
@@ -73,17 +145,17 @@ private:
   void DI();
   void EI();
 
-  void RLC();
-  void RRC();
-  void RL();
-  void RR();
-  void SLA();
-  void SRA();
-  void SWAP();
-  void SRL();
-  void BIT();
-  void RES();
-  void SET();
+  template<uint8_t index> void RLC();
+  template<uint8_t index> void RRC();
+  template<uint8_t index> void RL();
+  template<uint8_t index> void RR();
+  template<uint8_t index> void SLA();
+  template<uint8_t index> void SRA();
+  template<uint8_t index> void SWAP();
+  template<uint8_t index> void SRL();
+  template<uint8_t bit, uint8_t index> void BIT();
+  template<uint8_t bit, uint8_t index> void RES();
+  template<uint8_t bit, uint8_t index> void SET();
 
   void HCF();
 
@@ -98,8 +170,25 @@ private:
   uint16_t pc;
   uint16_t sp;
   uint8_t ir;
+
+  // flags left by the last ALU op, computed into f only when read
+  enum : uint8_t { FLAGS_F, FLAGS_ADD, FLAGS_SUB, FLAGS_AND, FLAGS_OR, FLAGS_INC, FLAGS_DEC };
+  uint8_t flagOp;  // FLAGS_F when f is up to date
+  uint8_t flagX;  // operands, or the carry flag in flagY for INC and DEC
+  uint8_t flagY;
+  uint16_t flagResult;  // result, with carry or borrow in bit 8
   bool ime[2];
   uint8_t _if;
   uint8_t _ie;
+
+  // block cache state
+  std::unordered_map<uint8_t*, CodePage*> codeCache;
+  Block* block;
+  uint16_t blockIndex;
+  uint16_t blockPc;
+  bool cached;  // current instruction was pre-decoded
+  Op op;
+  uint8_t opFetched;
 };
 
+#include "sm83.tpp"
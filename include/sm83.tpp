@@ -0,0 +1,788 @@
+template<class Bus> void SM83<Bus>::reset() {
+  pc = 0x0000;
+  block = NULL;
+  ime[0] = false;
+  ime[1] = false;
+  setIF(0x00);
+  setIE(0x00);
+}
+
+template<class Bus> void SM83<Bus>::instruction() {
+  if(ime[0] && (_if & _ie)) {
+    ime[0] = false;
+    ime[1] = false;
+    if(_if & _ie & 0x01) { _if &= ~0x01; runISR(0x0040); return; }
+    if(_if & _ie & 0x02) { _if &= ~0x02; runISR(0x0048); return; }
+    if(_if & _ie & 0x04) { _if &= ~0x04; runISR(0x0050); return; }
+    if(_if & _ie & 0x08) { _if &= ~0x08; runISR(0x0058); return; }
+    if(_if & _ie & 0x10) { _if &= ~0x10; runISR(0x0060); return; }
+  }
+  ime[0] = ime[1];
+
+  cached = blockCache && nextOp();
+  opFetched = 0;
+  ir = fetch8();
+  (this->*(cached ? op.handler : opTable.handlers[ir]))();
+}
+
+// handler for one opcode, with its register operands resolved at compile time
+template<class Bus> template<uint8_t opcode> void SM83<Bus>::instructionOp() {
+  constexpr uint8_t dst = (opcode >> 3) & 0x07;
+  constexpr uint8_t src = opcode & 0x07;
+  switch(opcode) {
+
+  // 00-3f: misc. ops
+  case 0x00:                                     return;  // NOP
+  case 0x01: c = fetch8(); b = fetch8();         return;  // LD BC,nn
+  case 0x02: bus()->cycleWrite(b << 8 | c, a);   return;  // LD (BC),A
+  case 0x03: if(!(++c)) b++; bus()->cycleIdle(); return;  // INC BC
+  case 0x04: return INC<dst>();
+  case 0x05: return DEC<dst>();
+  case 0x06: return regWrite<dst>(fetch8());
+  case 0x07: return RLCA();
+  case 0x08: write16(fetch16(), sp);             return;  // LD (nn),SP
+  case 0x09: ADD16(b << 8 | c);                  return;  // ADD HL,BC
+  case 0x0a: a = bus()->cycleRead(b << 8 | c);   return;  // LD A,(BC)
+  case 0x0b: bus()->cycleIdle(); if(!(c--)) b--; return;  // DEC BC
+  case 0x0c: return INC<dst>();
+  case 0x0d: return DEC<dst>();
+  case 0x0e: return regWrite<dst>(fetch8());
+  case 0x0f: return RRCA();
+  case 0x10: STOP();                             return;  // STOP
+  case 0x11: e = fetch8(); d = fetch8();         return;  // LD DE,nn
+  case 0x12: bus()->cycleWrite(d << 8 | e, a);   return;  // LD (DE),A
+  case 0x13: if(!(++e)) d++; bus()->cycleIdle(); return;  // INC DE
+  case 0x14: return INC<dst>();
+  case 0x15: return DEC<dst>();
+  case 0x16: return regWrite<dst>(fetch8());
+  case 0x17: return RLA();
+  case 0x18: JR(true);                           return;  // JR e
+  case 0x19: ADD16(d << 8 | e);                  return;  // ADD HL,DE
+  case 0x1a: a = bus()->cycleRead(d << 8 | e);   return;  // LD A,(DE)
+  case 0x1b: bus()->cycleIdle(); if(!(e--)) d--; return;  // DEC DE
+  case 0x1c: return INC<dst>();
+  case 0x1d: return DEC<dst>();
+  case 0x1e: return regWrite<dst>(fetch8());
+  case 0x1f: return RRA();
+  case 0x20: JR(!ZF());                          return;  // JR NZ,e
+  case 0x21: l = fetch8(); h = fetch8();         return;  // LD HL,nn
+  case 0x22: bus()->cycleWrite(incHL(), a);      return;  // LD (HL+),A
+  case 0x23: if(!(++l)) h++; bus()->cycleIdle(); return;  // INC HL
+  case 0x24: return INC<dst>();
+  case 0x25: return DEC<dst>();
+  case 0x26: return regWrite<dst>(fetch8());
+  case 0x27: return DAA();
+  case 0x28: JR(ZF());                           return;  // JR Z,e
+  case 0x29: ADD16(HL());                        return;  // ADD HL,HL
+  case 0x2a: a = bus()->cycleRead(incHL());      return;  // LD A,(HL+)
+  case 0x2b: bus()->cycleIdle(); if(!(l--)) h--; return;  // DEC HL
+  case 0x2c: return INC<dst>();
+  case 0x2d: return DEC<dst>();
+  case 0x2e: return regWrite<dst>(fetch8());
+  case 0x2f: return CPL();
+  case 0x30: JR(!CF());                          return;  // JR NC,e
+  case 0x31: sp = fetch16();                     return;  // LD SP,nn
+  case 0x32: bus()->cycleWrite(decHL(), a);      return;  // LD (HL-),A
+  case 0x33: sp++; bus()->cycleIdle();           return;  // INC SP
+  case 0x34: return INC<dst>();
+  case 0x35: return DEC<dst>();
+  case 0x36: return regWrite<dst>(fetch8());
+  case 0x37: return SCF();
+  case 0x38: JR(CF());                           return;  // JR C,e
+  case 0x39: ADD16(sp);                          return;  // ADD HL,SP
+  case 0x3a: a = bus()->cycleRead(decHL());      return;  // LD A,(HL-)
+  case 0x3b: bus()->cycleIdle(); sp--;           return;  // DEC SP
+  case 0x3c: return INC<dst>();
+  case 0x3d: return DEC<dst>();
+  case 0x3e: return regWrite<dst>(fetch8());
+  case 0x3f: return CCF();
+
+  // 40-7f: LD instruction
+  case 0x40 ... 0x75: return regWrite<dst>(regRead<src>());
+  case 0x76:          return HALT();
+  case 0x77 ... 0x7f: return regWrite<dst>(regRead<src>());
+
+  // 80-bf: ALU ops
+  case 0x80 ... 0x87: return ADD(regRead<src>());
+  case 0x88 ... 0x8f: return ADC(regRead<src>());
+  case 0x90 ... 0x97: return SUB(regRead<src>());
+  case 0x98 ... 0x9f: return SBC(regRead<src>());
+  case 0xa0 ... 0xa7: return AND(regRead<src>());
+  case 0xa8 ... 0xaf: return XOR(regRead<src>());
+  case 0xb0 ... 0xb7: return  OR(regRead<src>());
+  case 0xb8 ... 0xbf: return  CP(regRead<src>());
+
+  // c0-ff: control flow
+  case 0xc0: bus()->cycleIdle(); RET(!ZF());           return;  // RET NZ
+  case 0xc1: c = pop8(); b = pop8();                   return;  // POP BC
+  case 0xc2: JP(!ZF());                                return;  // JP NZ,nn
+  case 0xc3: JP(true);                                 return;  // JP nn
+  case 0xc4: CALL(!ZF());                              return;  // CALL NZ,nn
+  case 0xc5: bus()->cycleIdle(); push8(b); push8(c);   return;  // PUSH BC
+  case 0xc6: ADD(fetch8());                            return;  // ADD n
+  case 0xc7: RST(0x0000);                              return;  // RST 0x00
+  case 0xc8: bus()->cycleIdle(); RET(ZF());            return;  // RET Z
+  case 0xc9: RET(true);                                return;  // RET
+  case 0xca: JP(ZF());                                 return;  // JP Z,nn
+  case 0xcb: instructionCB();                          return;  // CB-prefixed instruction
+  case 0xcc: CALL(ZF());                               return;  // CALL Z,nn
+  case 0xcd: CALL(true);                               return;  // CALL nn
+  case 0xce: ADC(fetch8());                            return;  // ADC n
+  case 0xcf: RST(0x0008);                              return;  // RST 0x08
+  case 0xd0: bus()->cycleIdle(); RET(!CF());           return;  // RET NC
+  case 0xd1: e = pop8(); d = pop8();                   return;  // POP DE
+  case 0xd2: JP(!CF());                                return;  // JP NC,nn
+  case 0xd3: HCF();                                    return;
+  case 0xd4: CALL(!CF());                              return;  // CALL NC,nn
+  case 0xd5: bus()->cycleIdle(); push8(d); push8(e);   return;  // PUSH DE
+  case 0xd6: SUB(fetch8());                            return;  // SUB n
+  case 0xd7: RST(0x0010);                              return;  // RST 0x10
+  case 0xd8: bus()->cycleIdle(); RET(CF());            return;  // RET C
+  case 0xd9: RETI();                                   return;  // RETI
+  case 0xda: JP(CF());                                 return;  // JP C,nn
+  case 0xdb: HCF();                                    return;
+  case 0xdc: CALL(CF());                               return;  // CALL C,nn
+  case 0xdd: HCF();                                    return;
+  case 0xde: SBC(fetch8());                            return;  // SBC n
+  case 0xdf: RST(0x0018);                              return;  // RST 0x18
+  case 0xe0: bus()->cycleWrite(0xff00 + fetch8(), a);  return;  // LDH (n),A
+  case 0xe1: l = pop8(); h = pop8();                   return;  // POP HL
+  case 0xe2: bus()->cycleWrite(0xff00 + c, a);         return;  // LDH (C),A
+  case 0xe3: HCF();                                    return;
+  case 0xe4: HCF();                                    return;
+  case 0xe5: bus()->cycleIdle(); push8(h); push8(l);   return;  // PUSH HL
+  case 0xe6: AND(fetch8());                            return;  // AND n
+  case 0xe7: RST(0x0020);                              return;  // RST 0x20
+  case 0xe8: sp = addSP(); bus()->cycleIdle();         return;  // ADD SP,e
+  case 0xe9: pc = HL();                                return;  // JP HL
+  case 0xea: bus()->cycleWrite(fetch16(), a);          return;  // LD (nn),A
+  case 0xeb: HCF();                                    return;
+  case 0xec: HCF();                                    return;
+  case 0xed: HCF();                                    return;
+  case 0xee: XOR(fetch8());                            return;  // XOR n
+  case 0xef: RST(0x0028);                              return;  // RST 0x28
+  case 0xf0: a = bus()->cycleRead(0xff00 + fetch8());  return;  // LDH A,(n)
+  case 0xf1: setF(pop8()); a = pop8();                 return;  // POP AF
+  case 0xf2: a = bus()->cycleRead(0xff00 + c);         return;  // LDH A,(C)
+  case 0xf3: DI();                                     return;  // DI
+  case 0xf4: HCF();                                    return;
+  case 0xf5: bus()->cycleIdle(); push8(a); push8(F()); return;  // PUSH AF
+  case 0xf6: OR(fetch8());                             return;  // OR n
+  case 0xf7: RST(0x0030);                              return;  // RST 0x30
+  case 0xf8: setHL(addSP());                           return;  // LD HL,SP+e
+  case 0xf9: sp = HL(); bus()->cycleIdle();            return;  // LD SP,HL
+  case 0xfa: a = bus()->cycleRead(fetch16());          return;  // LD A,(nn)
+  case 0xfb: EI();                                     return;  // EI
+  case 0xfc: HCF();                                    return;
+  case 0xfd: HCF();                                    return;
+  case 0xfe: CP(fetch8());                             return;  // CP n
+  case 0xff: RST(0x0038);                              return;  // RST 0x38
+
+  }
+
+  // unreachable
+}
+
+template<class Bus> void SM83<Bus>::instructionCB() {
+  ir = fetch8();
+  (this->*cbTable.handlers[ir])();
+}
+
+template<class Bus> template<uint8_t opcode> void SM83<Bus>::instructionOpCB() {
+  constexpr uint8_t bit = (opcode >> 3) & 0x07;
+  constexpr uint8_t reg = opcode & 0x07;
+  switch(opcode) {
+  case 0x00 ... 0x07: return RLC<reg>();
+  case 0x08 ... 0x0f: return RRC<reg>();
+  case 0x10 ... 0x17: return RL<reg>();
+  case 0x18 ... 0x1f: return RR<reg>();
+  case 0x20 ... 0x27: return SLA<reg>();
+  case 0x28 ... 0x2f: return SRA<reg>();
+  case 0x30 ... 0x37: return SWAP<reg>();
+  case 0x38 ... 0x3f: return SRL<reg>();
+  case 0x40 ... 0x7f: return BIT<bit, reg>();
+  case 0x80 ... 0xbf: return RES<bit, reg>();
+  case 0xc0 ... 0xff: return SET<bit, reg>();
+  }
+
+  // unreachable
+}
+
+template<class Bus> template<std::size_t... opcodes>
+constexpr typename SM83<Bus>::HandlerTable SM83<Bus>::buildTable(std::index_sequence<opcodes...>) {
+  return {{ &SM83::instructionOp<opcodes>... }};
+}
+
+template<class Bus> template<std::size_t... opcodes>
+constexpr typename SM83<Bus>::HandlerTable SM83<Bus>::buildTableCB(std::index_sequence<opcodes...>) {
+  return {{ &SM83::instructionOpCB<opcodes>... }};
+}
+
+template<class Bus> constexpr typename SM83<Bus>::HandlerTable SM83<Bus>::opTable = SM83<Bus>::buildTable(std::make_index_sequence<0x100>());
+template<class Bus> constexpr typename SM83<Bus>::HandlerTable SM83<Bus>::cbTable = SM83<Bus>::buildTableCB(std::make_index_sequence<0x100>());
+
+template<class Bus> bool SM83<Bus>::nextOp() {
+  // find a new block, unless continuing sequentially through the current one
+  if(!block || pc != blockPc || blockIndex >= block->ops.size()) {
+    block = findBlock(pc);
+    blockIndex = 0;
+    if(!block) return false;
+  }
+  op = block->ops[blockIndex++];
+  blockPc = pc + op.length;
+  return true;
+}
+
+template<class Bus> typename SM83<Bus>::Block* SM83<Bus>::findBlock(uint16_t addr) {
+  uint8_t* page = bus()->codePage(addr);
+  if(!page) return NULL;
+
+  // find cached page, or start caching it
+  CodePage*& cachedPage = codeCache[page];
+  if(!cachedPage) {
+    cachedPage = new CodePage();
+    bus()->protectCode(addr);
+  }
+
+  // find cached block, or decode it
+  Block*& found = cachedPage->blocks[addr & 0xff];
+  if(!found) found = decodeBlock(page, addr & 0xff);
+  return found->ops.empty() ? NULL : found;
+}
+
+template<class Bus> typename SM83<Bus>::Block* SM83<Bus>::decodeBlock(uint8_t* page, uint8_t index) {
+  Block* decoded = new Block();
+  for(int i = index; i < 0x100;) {
+    // stop at instructions that cross into the next page
+    uint8_t opcode = page[i];
+    uint8_t length = opLength(opcode);
+    if(i + length > 0x100) break;
+
+    Op next;
+    for(int j = 0; j < 3; j++) next.bytes[j] = (j < length) ? page[i + j] : 0x00;
+    next.length = length;
+    next.handler = opTable.handlers[opcode];
+    decoded->ops.push_back(next);
+
+    i += length;
+    if(opEndsBlock(opcode)) break;
+  }
+  return decoded;
+}
+
+template<class Bus> uint8_t SM83<Bus>::opLength(uint8_t opcode) {
+  switch(opcode) {
+  case 0x06: case 0x0e: case 0x16: case 0x1e: case 0x26: case 0x2e: case 0x36: case 0x3e:  // LD r,n
+  case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:  // JR
+  case 0xc6: case 0xce: case 0xd6: case 0xde: case 0xe6: case 0xee: case 0xf6: case 0xfe:  // ALU n
+  case 0xcb: case 0xe0: case 0xe8: case 0xf0: case 0xf8:
+    return 2;
+  case 0x01: case 0x11: case 0x21: case 0x31: case 0x08:  // LD rr,nn and LD (nn),SP
+  case 0xc2: case 0xc3: case 0xca: case 0xd2: case 0xda:  // JP
+  case 0xc4: case 0xcc: case 0xcd: case 0xd4: case 0xdc:  // CALL
+  case 0xea: case 0xfa:
+    return 3;
+  }
+  return 1;
+}
+
+template<class Bus> bool SM83<Bus>::opEndsBlock(uint8_t opcode) {
+  switch(opcode) {
+  case 0x10: case 0x76:  // STOP, HALT
+  case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:  // JR
+  case 0xc2: case 0xc3: case 0xca: case 0xd2: case 0xda: case 0xe9:  // JP
+  case 0xc4: case 0xcc: case 0xcd: case 0xd4: case 0xdc:  // CALL
+  case 0xc0: case 0xc8: case 0xc9: case 0xd0: case 0xd8: case 0xd9:  // RET
+  case 0xc7: case 0xcf: case 0xd7: case 0xdf: case 0xe7: case 0xef: case 0xf7: case 0xff:  // RST
+  case 0xd3: case 0xdb: case 0xdd: case 0xe3: case 0xe4: case 0xeb: case 0xec: case 0xed: case 0xf4: case 0xfc: case 0xfd:  // illegal
+    return true;
+  }
+  return false;
+}
+
+template<class Bus> void SM83<Bus>::flushCode(uint8_t* page) {
+  // drop all blocks cached from a page that was written to
+  auto found = codeCache.find(page);
+  if(found == codeCache.end()) return;
+  freeCodePage(found->second);
+  codeCache.erase(found);
+  block = NULL;
+}
+
+template<class Bus> void SM83<Bus>::freeCodePage(CodePage* page) {
+  for(int i = 0; i < 0x100; i++) delete page->blocks[i];
+  delete page;
+}
+
+template<class Bus> template<uint8_t index> uint8_t SM83<Bus>::regRead() {
+  switch(index) {
+  case 0x00: return b;
+  case 0x01: return c;
+  case 0x02: return d;
+  case 0x03: return e;
+  case 0x04: return h;
+  case 0x05: return l;
+  case 0x06: return bus()->cycleRead(HL());
+  case 0x07: return a;
+  }
+
+  // unreachable
+  return 0xff;
+}
+
+template<class Bus> template<uint8_t index> void SM83<Bus>::regWrite(uint8_t data) {
+  switch(index) {
+  case 0x00: b = data;                      return;
+  case 0x01: c = data;                      return;
+  case 0x02: d = data;                      return;
+  case 0x03: e = data;                      return;
+  case 0x04: h = data;                      return;
+  case 0x05: l = data;                      return;
+  case 0x06: bus()->cycleWrite(HL(), data); return;
+  case 0x07: a = data;                      return;
+  }
+
+  // unreachable
+}
+
+template<class Bus> void SM83<Bus>::runISR(uint16_t addr) {
+  bus()->cycleIdle();
+  bus()->cycleIdle();
+  push16(pc);
+  bus()->cycleIdle();
+  pc = addr;
+}
+
+template<class Bus> void SM83<Bus>::write16(uint16_t addr, uint16_t data) {
+  bus()->cycleWrite(addr, data);
+  bus()->cycleWrite(addr + 1, data >> 8);
+}
+
+template<class Bus> uint8_t SM83<Bus>::fetch8() {
+  // pre-decoded bytes come from cacheable memory, so reading them again has no side effects
+  if(cached) {
+    bus()->cycleIdle();
+    pc++;
+    return op.bytes[opFetched++];
+  }
+  return bus()->cycleRead(pc++);
+}
+
+template<class Bus> uint16_t SM83<Bus>::fetch16() {
+  uint16_t data = bus()->cycleRead(pc++);
+  return bus()->cycleRead(pc++) << 8 | data;
+}
+
+template<class Bus> void SM83<Bus>::push8(uint8_t data) {
+  bus()->cycleWrite(--sp, data);
+}
+
+template<class Bus> void SM83<Bus>::push16(uint16_t data) {
+  push8(data >> 8);
+  push8(data);
+}
+
+template<class Bus> uint8_t SM83<Bus>::pop8() {
+  return bus()->cycleRead(sp++);
+}
+
+template<class Bus> uint16_t SM83<Bus>::pop16() {
+  uint16_t data = pop8();
+  return pop8() << 8 | data;
+}
+
+template<class Bus> uint16_t SM83<Bus>::HL() {
+  return h << 8 | l;
+}
+
+template<class Bus> void SM83<Bus>::setHL(uint16_t data) {
+  h = data >> 8;
+  l = data;
+}
+
+template<class Bus> uint16_t SM83<Bus>::incHL() {
+  uint16_t hlPrev = HL();
+  uint16_t hl = hlPrev + 1;
+  l = hl;
+  h = hl >> 8;
+  return hlPrev;
+}
+
+template<class Bus> uint16_t SM83<Bus>::decHL() {
+  uint16_t hlPrev = HL();
+  uint16_t hl = hlPrev - 1;
+  l = hl;
+  h = hl >> 8;
+  return hlPrev;
+}
+
+template<class Bus> uint16_t SM83<Bus>::addSP() {
+  uint16_t data = (int16_t)(int8_t)fetch8();
+  uint8_t findH = (sp & 0x000f) + (data & 0x000f);
+  uint16_t findC = (sp & 0x00ff) + (data & 0x00ff);
+  uint16_t result = sp + data;
+  setFlags(false, false, findH & 0x10, findC & 0x100);
+  bus()->cycleIdle();
+  return result;
+}
+
+template<class Bus> uint8_t SM83<Bus>::F() {
+  syncFlags();
+  return f;
+}
+
+template<class Bus> void SM83<Bus>::setF(uint8_t data) {
+  f = data & 0xf0;
+  flagOp = FLAGS_F;
+}
+
+template<class Bus> void SM83<Bus>::setFlags(bool z, bool n, bool h, bool c) {
+  f = z << 7 | n << 6 | h << 5 | c << 4;
+  flagOp = FLAGS_F;
+}
+
+template<class Bus> void SM83<Bus>::syncFlags() {
+  bool z = !(uint8_t)flagResult;
+  switch(flagOp) {
+  case FLAGS_F:   return;
+  case FLAGS_ADD: f = z << 7 | ((flagX ^ flagY ^ flagResult) & 0x10) << 1 | (flagResult & 0x100) >> 4; break;
+  case FLAGS_SUB: f = z << 7 | 0x40 | ((flagX ^ flagY ^ flagResult) & 0x10) << 1 | (flagResult & 0x100) >> 4; break;
+  case FLAGS_AND: f = z << 7 | 0x20; break;
+  case FLAGS_OR:  f = z << 7; break;
+  case FLAGS_INC: f = z << 7 | ((flagResult & 0x0f) == 0x00) << 5 | flagY << 4; break;
+  case FLAGS_DEC: f = z << 7 | 0x40 | ((flagResult & 0x0f) == 0x0f) << 5 | flagY << 4; break;
+  }
+  flagOp = FLAGS_F;
+}
+
+template<class Bus> void SM83<Bus>::setZ(bool cond) {
+  f &= 0x7f;
+  if(cond) f |= 0x80;
+}
+
+template<class Bus> void SM83<Bus>::setN(bool cond) {
+  f &= 0xbf;
+  if(cond) f |= 0x40;
+}
+
+template<class Bus> void SM83<Bus>::setH(bool cond) {
+  f &= 0xdf;
+  if(cond) f |= 0x20;
+}
+
+template<class Bus> void SM83<Bus>::setC(bool cond) {
+  f &= 0xef;
+  if(cond) f |= 0x10;
+}
+
+template<class Bus> bool SM83<Bus>::ZF() {
+  if(flagOp == FLAGS_F) return f & 0x80;
+  return !(uint8_t)flagResult;
+}
+
+template<class Bus> bool SM83<Bus>::NF() {
+  syncFlags();
+  return f & 0x40;
+}
+
+template<class Bus> bool SM83<Bus>::HF() {
+  syncFlags();
+  return f & 0x20;
+}
+
+template<class Bus> bool SM83<Bus>::CF() {
+  switch(flagOp) {
+  case FLAGS_ADD:
+  case FLAGS_SUB: return flagResult & 0x100;
+  case FLAGS_AND:
+  case FLAGS_OR:  return false;
+  case FLAGS_INC:
+  case FLAGS_DEC: return flagY;
+  }
+  return f & 0x10;
+}
+
+template<class Bus> template<uint8_t index> void SM83<Bus>::INC() {
+  uint8_t data = regRead<index>();
+  lazyFlags(FLAGS_INC, data, CF(), (uint8_t)(data + 1));
+  regWrite<index>(data + 1);
+}
+
+template<class Bus> template<uint8_t index> void SM83<Bus>::DEC() {
+  uint8_t data = regRead<index>();
+  lazyFlags(FLAGS_DEC, data, CF(), (uint8_t)(data - 1));
+  regWrite<index>(data - 1);
+}
+
+template<class Bus> void SM83<Bus>::RLCA() {
+  bool carry = a & 0x80;
+  a <<= 1;
+  if(carry) a |= 0x01;
+  setFlags(false, false, false, carry);
+}
+
+template<class Bus> void SM83<Bus>::RRCA() {
+  bool carry = a & 0x01;
+  a >>= 1;
+  if(carry) a |= 0x80;
+  setFlags(false, false, false, carry);
+}
+
+template<class Bus> void SM83<Bus>::RLA() {
+  bool carry = a & 0x80;
+  a <<= 1;
+  if(CF()) a |= 0x01;
+  setFlags(false, false, false, carry);
+}
+
+template<class Bus> void SM83<Bus>::RRA() {
+  bool carry = a & 0x01;
+  a >>= 1;
+  if(CF()) a |= 0x80;
+  setFlags(false, false, false, carry);
+}
+
+template<class Bus> void SM83<Bus>::ADD16(uint16_t data) {
+  syncFlags();
+  uint16_t partial = (HL() & 0x0fff) + (data & 0x0fff);
+  uint32_t result = HL() + data;
+  setN(false);
+  setH(partial & 0x1000);
+  setC(result & 0x10000);
+  h = result >> 8;
+  l = result;
+  bus()->cycleIdle();
+}
+
+template<class Bus> void SM83<Bus>::STOP() {
+  // todo: implement cases where STOP acts differently from a NOP
+}
+
+template<class Bus> void SM83<Bus>::JR(bool cond) {
+  int16_t displacement = (int8_t)fetch8();
+  if(cond) {
+    pc += displacement;
+    bus()->cycleIdle();
+  }
+}
+
+template<class Bus> void SM83<Bus>::DAA() {
+  syncFlags();
+  uint8_t data = 0x00;
+  if(NF()) {
+    if(HF()) data += 0x06;
+    if(CF()) data += 0x60;
+    a += ~data + 1;
+    setZ(a == 0);
+    setH(0);
+  } else {
+    if(HF() || ((a & 0x0f) > 0x09)) data += 0x06;
+    if(CF() || (a > 0x99)) data += 0x60;
+    uint16_t result = a + data;
+    a = result;
+    setZ(a == 0);
+    setH(0);
+    setC(CF() || (result & 0x0100));
+  }
+}
+
+template<class Bus> void SM83<Bus>::CPL() {
+  syncFlags();
+  a = ~a;
+  setN(true);
+  setH(true);
+}
+
+template<class Bus> void SM83<Bus>::SCF() {
+  syncFlags();
+  setN(false);
+  setH(false);
+  setC(true);
+}
+
+template<class Bus> void SM83<Bus>::CCF() {
+  syncFlags();
+  setN(false);
+  setH(false);
+  setC(!CF());
+}
+
+template<class Bus> void SM83<Bus>::HALT() {
+  while(!(_if & _ie)) bus()->cycleHalt();
+}
+
+template<class Bus> void SM83<Bus>::ADD(uint8_t data) {
+  uint16_t result = a + data;
+  lazyFlags(FLAGS_ADD, a, data, result);
+  a = result;
+}
+
+template<class Bus> void SM83<Bus>::ADC(uint8_t data) {
+  uint16_t result = a + data + CF();
+  lazyFlags(FLAGS_ADD, a, data, result);
+  a = result;
+}
+
+template<class Bus> void SM83<Bus>::SUB(uint8_t data) {
+  uint16_t result = a - data;
+  lazyFlags(FLAGS_SUB, a, data, result);
+  a = result;
+}
+
+template<class Bus> void SM83<Bus>::SBC(uint8_t data) {
+  uint16_t result = a - data - CF();
+  lazyFlags(FLAGS_SUB, a, data, result);
+  a = result;
+}
+
+template<class Bus> void SM83<Bus>::AND(uint8_t data) {
+  a &= data;
+  lazyFlags(FLAGS_AND, 0, 0, a);
+}
+
+template<class Bus> void SM83<Bus>::XOR(uint8_t data) {
+  a ^= data;
+  lazyFlags(FLAGS_OR, 0, 0, a);
+}
+
+template<class Bus> void SM83<Bus>::OR(uint8_t data) {
+  a |= data;
+  lazyFlags(FLAGS_OR, 0, 0, a);
+}
+
+template<class Bus> void SM83<Bus>::CP(uint8_t data) {
+  lazyFlags(FLAGS_SUB, a, data, a - data);
+}
+
+template<class Bus> void SM83<Bus>::RET(bool cond) {
+  if(cond) {
+    pc = pop16();
+    bus()->cycleIdle();
+  }
+}
+
+template<class Bus> void SM83<Bus>::JP(bool cond) {
+  uint16_t target = fetch16();
+  if(cond) {
+    pc = target;
+    bus()->cycleIdle();
+  }
+}
+
+template<class Bus> void SM83<Bus>::CALL(bool cond) {
+  uint16_t target = fetch16();
+  if(cond) {
+    bus()->cycleIdle();
+    push16(pc);
+    pc = target;
+  }
+}
+
+template<class Bus> void SM83<Bus>::RST(uint16_t addr) {
+  bus()->cycleIdle();
+  push16(pc);
+  pc = addr;
+}
+
+template<class Bus> void SM83<Bus>::RETI() {
+  ime[0] = true;
+  ime[1] = true;
+  pc = pop16();
+  bus()->cycleIdle();
+}
+
+template<class Bus> void SM83<Bus>::DI() {
+  ime[0] = false;
+  ime[1] = false;
+}
+
+template<class Bus> void SM83<Bus>::EI() {
+  ime[1] = true;
+}
+
+template<class Bus> template<uint8_t index> void SM83<Bus>::RLC() {
+  uint8_t data = regRead<index>();
+  bool carry = data & 0x80;
+  data <<= 1;
+  if(carry) data |= 0x01;
+  setFlags(data == 0, false, false, carry);
+  regWrite<index>(data);
+}
+
+template<class Bus> template<uint8_t index> void SM83<Bus>::RRC() {
+  uint8_t data = regRead<index>();
+  bool carry = data & 0x01;
+  data >>= 1;
+  if(carry) data |= 0x80;
+  setFlags(data == 0, false, false, carry);
+  regWrite<index>(data);
+}
+
+template<class Bus> template<uint8_t index> void SM83<Bus>::RL() {
+  uint8_t data = regRead<index>();
+  bool carry = data & 0x80;
+  data <<= 1;
+  if(CF()) data |= 0x01;
+  setFlags(data == 0, false, false, carry);
+  regWrite<index>(data);
+}
+
+template<class Bus> template<uint8_t index> void SM83<Bus>::RR() {
+  uint8_t data = regRead<index>();
+  bool carry = data & 0x01;
+  data >>= 1;
+  if(CF()) data |= 0x80;
+  setFlags(data == 0, false, false, carry);
+  regWrite<index>(data);
+}
+
+template<class Bus> template<uint8_t index> void SM83<Bus>::SLA() {
+  uint8_t data = regRead<index>();
+  bool carry = data & 0x80;
+  data <<= 1;
+  setFlags(data == 0, false, false, carry);
+  regWrite<index>(data);
+}
+
+template<class Bus> template<uint8_t index> void SM83<Bus>::SRA() {
+  uint8_t data = regRead<index>();
+  bool carry = data & 0x01;
+  data = (int8_t)data >> 1;
+  setFlags(data == 0, false, false, carry);
+  regWrite<index>(data);
+}
+
+template<class Bus> template<uint8_t index> void SM83<Bus>::SWAP() {
+  uint8_t data = regRead<index>();
+  data = data << 4 | data >> 4;
+  setFlags(data == 0, false, false, false);
+  regWrite<index>(data);
+}
+
+template<class Bus> template<uint8_t index> void SM83<Bus>::SRL() {
+  uint8_t data = regRead<index>();
+  bool carry = data & 0x01;
+  data >>= 1;
+  setFlags(data == 0, false, false, carry);
+  regWrite<index>(data);
+}
+
+template<class Bus> template<uint8_t bit, uint8_t index> void SM83<Bus>::BIT() {
+  syncFlags();
+  setZ(!(regRead<index>() & 1 << bit));
+  setN(false);
+  setH(true);
+}
+
+template<class Bus> template<uint8_t bit, uint8_t index> void SM83<Bus>::RES() {
+  regWrite<index>(regRead<index>() & ~(1 << bit));
+}
+
+template<class Bus> template<uint8_t bit, uint8_t index> void SM83<Bus>::SET() {
+  regWrite<index>(regRead<index>() | 1 << bit);
+}
+
+template<class Bus> void SM83<Bus>::HCF() {
+  for(;;) bus()->cycleIdle();
+}
+
@@ -1,101 +1,5 @@
 #include "apu.hpp"
 
-uint8_t APU::apuReadIO(uint16_t addr) {
-  if(addr == 0xff10) return ch1.readNRx0();  // NR10
-  if(addr == 0xff11) return ch1.readNRx1();  // NR11
-  if(addr == 0xff12) return ch1.readNRx2();  // NR12
-  if(addr == 0xff14) return ch1.readNRx4();  // NR14
-  if(addr == 0xff16) return ch2.readNRx1();  // NR21
-  if(addr == 0xff17) return ch2.readNRx2();  // NR22
-  if(addr == 0xff19) return ch2.readNRx4();  // NR24
-  if(addr == 0xff1a) return ch3.readNRx0();  // NR30
-  if(addr == 0xff1c) return ch3.readNRx2();  // NR32
-  if(addr == 0xff1e) return ch3.readNRx4();  // NR34
-  if(addr == 0xff21) return ch4.readNRx2();  // NR42
-  if(addr == 0xff22) return ch4.readNRx3();  // NR43
-  if(addr == 0xff23) return ch4.readNRx4();  // NR44
-  if(addr == 0xff24) return nr50;  // NR50
-  if(addr == 0xff25) return nr51;  // NR51
-  if(addr == 0xff26) {
-    // NR52
-    uint8_t data = 0x70;
-    if(nr52) data |= 0x80;
-    if(ch4.active()) data |= 0x08;
-    if(ch3.active()) data |= 0x04;
-    if(ch2.active()) data |= 0x02;
-    if(ch1.active()) data |= 0x01;
-    return data;
-  }
-  if(addr >= 0xff30 && addr < 0xff40) return ch3.readRAM(addr);  // wave RAM
-  return 0xff;
-}
-
-void APU::apuWriteIO(uint16_t addr, uint8_t data) {
-  if(addr == 0xff1b) { ch3.writeNRx1(data); return; }  // NR31
-  if(addr == 0xff20) { ch4.writeNRx1(data); return; }  // NR41
-  if(addr == 0xff26) {
-    // NR52
-    nr52 = data & 0x80;
-    if(!nr52) {
-      ch1.disable();
-      ch2.disable();
-      ch3.disable();
-      ch4.disable();
-      nr50 = 0x00;
-      nr51 = 0x00;
-    }
-    return;
-  }
-  if(addr >= 0xff30 && addr < 0xff40) { ch3.writeRAM(addr, data); return; }  // wave RAM
-
-  // remaining registers are only writable if audio is enabled
-  if(!nr52) return;
-  if(addr == 0xff10) { ch1.writeNRx0(data); return; }  // NR10
-  if(addr == 0xff11) { ch1.writeNRx1(data); return; }  // NR11
-  if(addr == 0xff12) { ch1.writeNRx2(data); return; }  // NR12
-  if(addr == 0xff13) { ch1.writeNRx3(data); return; }  // NR13
-  if(addr == 0xff14) { ch1.writeNRx4(data); return; }  // NR14
-  if(addr == 0xff16) { ch2.writeNRx1(data); return; }  // NR21
-  if(addr == 0xff17) { ch2.writeNRx2(data); return; }  // NR22
-  if(addr == 0xff18) { ch2.writeNRx3(data); return; }  // NR23
-  if(addr == 0xff19) { ch2.writeNRx4(data); return; }  // NR24
-  if(addr == 0xff1a) { ch3.writeNRx0(data); return; }  // NR30
-  if(addr == 0xff1c) { ch3.writeNRx2(data); return; }  // NR32
-  if(addr == 0xff1d) { ch3.writeNRx3(data); return; }  // NR33
-  if(addr == 0xff1e) { ch3.writeNRx4(data); return; }  // NR34
-  if(addr == 0xff21) { ch4.writeNRx2(data); return; }  // NR42
-  if(addr == 0xff22) { ch4.writeNRx3(data); return; }  // NR43
-  if(addr == 0xff23) { ch4.writeNRx4(data); return; }  // NR44
-  if(addr == 0xff24) { nr50 = data; return; }  // NR50
-  if(addr == 0xff25) { nr51 = data; return; }  // NR51
-}
-
-void APU::apuTick() {
-  // output sample
-  int16_t sample = 0;
-  if(nr52) {
-    sample += ch1.tick();
-    sample += ch2.tick();
-    sample += ch3.tick(); ch3.tick();  // channel 3 runs twice as fast
-    sample += ch4.tick();
-  }
-  emitSample(sample);
-}
-
-void APU::divAPU() {
-  subdiv++;
-  ch1.divAPU();
-  ch2.divAPU();
-  ch3.divAPU();
-  ch4.divAPU();
-  if(!(subdiv & 0x03)) ch1.clockSweep();
-  if(!(subdiv & 0x07)) {
-    ch1.clockEnvelope();
-    ch2.clockEnvelope();
-    ch4.clockEnvelope();
-  }
-}
-
 uint8_t Length::readNRx4() {
   return (lengthEnable ? 0xff: 0xbf);
 }
@@ -225,25 +129,31 @@ bool CH1::active() {
   return channelOn;
 }
 
-int16_t CH1::tick() {
-  int16_t sample = 0;
-  if(channelOn) {
-    dutyTimer++;
-    if(dutyTimer == 0x0800) {
-      dutyTimer = activePeriod;
-      dutyStep = (dutyStep + 1) & 0x07;
-    }
-    bool isHigh = false;
-    switch(dutyCycle) {
-    case 0x00: isHigh = (                 dutyStep != 7); break;
-    case 0x01: isHigh = (dutyStep != 0 && dutyStep != 7); break;
-    case 0x02: isHigh = (dutyStep >  0 && dutyStep <= 4); break;
-    case 0x03: isHigh = (dutyStep == 0 || dutyStep == 7); break;
-    }
-    uint8_t data = isHigh ? volume : 0;
-    sample = ((data << 1) - 0x0f) * 0x0080;
+int16_t CH1::sample() {
+  if(!channelOn) return 0;
+  bool isHigh = false;
+  switch(dutyCycle) {
+  case 0x00: isHigh = (                 dutyStep != 7); break;
+  case 0x01: isHigh = (dutyStep != 0 && dutyStep != 7); break;
+  case 0x02: isHigh = (dutyStep >  0 && dutyStep <= 4); break;
+  case 0x03: isHigh = (dutyStep == 0 || dutyStep == 7); break;
+  }
+  uint8_t data = isHigh ? volume : 0;
+  return ((data << 1) - 0x0f) * 0x0080;
+}
+
+uint32_t CH1::stepCycles() {
+  if(!channelOn) return UINT32_MAX;
+  return 0x0800 - dutyTimer;
+}
+
+void CH1::run(uint32_t cycles) {
+  if(!channelOn) return;
+  dutyTimer += cycles;
+  if(dutyTimer == 0x0800) {
+    dutyTimer = activePeriod;
+    dutyStep = (dutyStep + 1) & 0x07;
   }
-  return sample;
 }
 
 void CH1::calcFrequency() {
@@ -331,21 +241,40 @@ bool CH3::active() {
   return channelOn;
 }
 
-int16_t CH3::tick() {
-  int16_t sample = 0;
-  if(channelOn) {
-    dutyTimer++;
+int16_t CH3::sample() {
+  if(!channelOn) return 0;
+  uint8_t data = (ram[sampleIndex >> 1] >> ((sampleIndex & 1) ? 0 : 4)) & 0x0f;
+  if(volume == 0x00) data = 0;
+  if(volume == 0x02) data >>= 1;
+  if(volume == 0x03) data >>= 2;
+  return ((data << 1) - 0x0f) * 0x0080;
+}
+
+uint32_t CH3::stepCycles() {
+  // output is sampled after the first of two ticks in each cycle
+  if(!channelOn) return UINT32_MAX;
+  if(sampleIndex != index) return 1;  // stepped on the second tick of the last cycle
+  return ((0x0800 - dutyTimer) >> 1) + 1;
+}
+
+void CH3::run(uint32_t cycles) {
+  if(!channelOn) return;
+  advance(cycles * 2 - 1);
+  sampleIndex = index;
+  advance(1);
+}
+
+void CH3::advance(uint32_t ticks) {
+  while(ticks) {
+    uint32_t step = 0x0800 - dutyTimer;
+    if(step > ticks) step = ticks;
+    dutyTimer += step;
+    ticks -= step;
     if(dutyTimer == 0x0800) {
       dutyTimer = period;
       index = (index + 1) & 0x1f;
     }
-    uint8_t data = (ram[index >> 1] >> ((index & 1) ? 0 : 4)) & 0x0f;
-    if(volume == 0x00) data = 0;
-    if(volume == 0x02) data >>= 1;
-    if(volume == 0x03) data >>= 2;
-    sample = ((data << 1) - 0x0f) * 0x0080;
   }
-  return sample;
 }
 
 uint8_t CH4::readNRx2() {
@@ -408,26 +337,33 @@ bool CH4::active() {
   return channelOn;
 }
 
-int16_t CH4::tick() {
-  int16_t sample = 0;
-  if(channelOn) {
-    clockTimer++;
-    uint32_t counterTarget = (clockDivider ? (clockDivider << 2) : 2) * (2 << clockShift);
-    if(clockTimer >= counterTarget) {
-      clockTimer = 0x00000000;
-      dutyStep = (dutyStep + 1) & 0x07;
-      uint16_t newBit = (!(((lfsr >> 1) ^ lfsr) & 0x01)) ? 0x8000 : 0x0000;
-      lfsr |= newBit;
-      if(lfsrWidth) {
-        lfsr &= 0xff7f;
-        lfsr |= newBit >> 8;
-      }
-      lfsr >>= 1;
+int16_t CH4::sample() {
+  if(!channelOn) return 0;
+  uint8_t data = (lfsr & 0x01) ? volume : 0;
+  return ((data << 1) - 0x0f) * 0x0080;
+}
+
+uint32_t CH4::stepCycles() {
+  if(!channelOn) return UINT32_MAX;
+  uint32_t counterTarget = (clockDivider ? (clockDivider << 2) : 2) * (2 << clockShift);
+  return (clockTimer < counterTarget) ? counterTarget - clockTimer : 1;
+}
+
+void CH4::run(uint32_t cycles) {
+  if(!channelOn) return;
+  clockTimer += cycles;
+  uint32_t counterTarget = (clockDivider ? (clockDivider << 2) : 2) * (2 << clockShift);
+  if(clockTimer >= counterTarget) {
+    clockTimer = 0x00000000;
+    dutyStep = (dutyStep + 1) & 0x07;
+    uint16_t newBit = (!(((lfsr >> 1) ^ lfsr) & 0x01)) ? 0x8000 : 0x0000;
+    lfsr |= newBit;
+    if(lfsrWidth) {
+      lfsr &= 0xff7f;
+      lfsr |= newBit >> 8;
     }
-    uint8_t data = (lfsr & 0x01) ? volume : 0;
-    sample = ((data << 1) - 0x0f) * 0x0080;
+    lfsr >>= 1;
   }
-  return sample;
 }
 
 void CH4::clockEnvelope() {
@@ -0,0 +1,112 @@
+#include "blip.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+void BlipBuffer::setRates(double clockRate, double sampleRate) {
+  factor = (uint64_t)(sampleRate / clockRate * 4294967296.0);
+}
+
+void BlipBuffer::setTaps(int count) {
+  if(count != 8 && count != 16 && count != 32) {
+    printf("Unsupported filter length: %d\n", count);
+    exit(1);
+  }
+  taps = count;
+  buildKernel();
+}
+
+void BlipBuffer::buildKernel() {
+  // build windowed sinc impulses, with the cutoff just below half the output rate (closer for longer, sharper filters)
+  const double cutoff = 1.0 - 1.6 / taps;
+  for(int phase = 0; phase < phases; phase++) {
+    double impulse[maxTaps];
+    double sum = 0.0;
+    for(int i = 0; i < taps; i++) {
+      double x = i - (taps / 2 - 1) - (double)phase / phases;  // distance from the step, in output samples
+      double sinc = x ? sin(M_PI * cutoff * x) / (M_PI * cutoff * x) : 1.0;
+      double window = 0.42 + 0.5 * cos(M_PI * x / (taps / 2)) + 0.08 * cos(2.0 * M_PI * x / (taps / 2));  // Blackman
+      impulse[i] = sinc * window;
+      sum += impulse[i];
+    }
+
+    // scale so that each step reaches exactly its full height, putting any rounding error in the largest tap
+    int total = 0;
+    int largest = 0;
+    for(int i = 0; i < taps; i++) {
+      kernel[phase][i] = lround(impulse[i] * 32768.0 / sum);
+      total += kernel[phase][i];
+      if(kernel[phase][i] > kernel[phase][largest]) largest = i;
+    }
+    kernel[phase][largest] += 32768 - total;
+  }
+}
+
+void BlipBuffer::clear() {
+  offset = 0;
+  avail = 0;
+  integrator = 0;
+  memset(buffer, 0, sizeof(buffer));
+}
+
+void BlipBuffer::addDelta(uint32_t time, int delta) {
+  uint64_t pos = offset + time * factor;
+  if((pos >> 32) >= bufferSize) return;
+  int32_t* out = &buffer[pos >> 32];
+  const int16_t* impulse = kernel[(pos & 0xffffffff) * phases >> 32];
+#if defined(__AVX2__)
+  // widen and scale 8 taps at a time
+  __m256i scale = _mm256_set1_epi32(delta);
+  for(int i = 0; i < taps; i += 8) {
+    __m256i taps32 = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(impulse + i)));
+    __m256i sum = _mm256_add_epi32(_mm256_loadu_si256((__m256i*)(out + i)), _mm256_mullo_epi32(taps32, scale));
+    _mm256_storeu_si256((__m256i*)(out + i), sum);
+  }
+#elif defined(__SSE2__)
+  // form 32-bit products of 8 taps at a time from their low and high halves
+  // note: deltas fit in 16 bits, as the channels sum to at most 4 * 1920
+  __m128i scale = _mm_set1_epi16(delta);
+  for(int i = 0; i < taps; i += 8) {
+    __m128i taps16 = _mm_loadu_si128((const __m128i*)(impulse + i));
+    __m128i lo = _mm_mullo_epi16(taps16, scale);
+    __m128i hi = _mm_mulhi_epi16(taps16, scale);
+    __m128i sum0 = _mm_add_epi32(_mm_loadu_si128((__m128i*)(out + i)), _mm_unpacklo_epi16(lo, hi));
+    __m128i sum1 = _mm_add_epi32(_mm_loadu_si128((__m128i*)(out + i + 4)), _mm_unpackhi_epi16(lo, hi));
+    _mm_storeu_si128((__m128i*)(out + i), sum0);
+    _mm_storeu_si128((__m128i*)(out + i + 4), sum1);
+  }
+#else
+  for(int i = 0; i < taps; i++) out[i] += impulse[i] * delta;
+#endif
+}
+
+void BlipBuffer::endFrame(uint32_t time) {
+  offset += time * factor;
+  avail = offset >> 32;
+}
+
+int BlipBuffer::readSamples(int16_t* out, int count, int stride) {
+  if(count > avail) count = avail;
+  for(int i = 0; i < count; i++) {
+    integrator += buffer[i];
+    int32_t sample = integrator >> 15;
+    if(sample < -32768) sample = -32768;
+    if(sample >  32767) sample =  32767;
+    out[i * stride] = sample;
+    integrator -= integrator >> 10;  // remove DC offset
+  }
+
+  // move the remaining samples, and the tails of steps past them, to the start of the buffer
+  int remaining = avail - count + maxTaps;
+  memmove(buffer, buffer + count, remaining * sizeof(int32_t));
+  memset(buffer + remaining, 0, count * sizeof(int32_t));
+  offset -= (uint64_t)count << 32;
+  avail -= count;
+  return count;
+}
@@ -0,0 +1,128 @@
+#include "capture.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+void AudioCapture::open(const char* path, int fileFormat, int rate) {
+  if(fileFormat < 0 || fileFormat >= CAPTURE_COUNT) {
+    printf("Unsupported capture format: %d\n", fileFormat);
+    exit(1);
+  }
+  close();
+  file = fopen(path, "wb");
+  if(!file) {
+    printf("ERROR: %s is not a valid file path\n", path);
+    exit(0);
+  }
+  format = fileFormat;
+  sampleRate = rate;
+  samplesWritten = 0;
+  closing = false;
+  if(format == CAPTURE_WAV16) writeHeader();  // sizes are patched in on close
+
+  block = new Block();
+  block->count = 0;
+  writer = std::thread(&AudioCapture::writerThread, this);
+}
+
+void AudioCapture::write(const int16_t* samples, int count) {
+  if(!file) return;
+  while(count) {
+    int n = blockSize - block->count;
+    if(n > count) n = count;
+    for(int i = 0; i < 2 * n; i++) block->samples[2 * block->count + i] = samples[i];
+    block->count += n;
+    samples += 2 * n;
+    count -= n;
+    if(block->count == blockSize) submitBlock();
+  }
+}
+
+void AudioCapture::close() {
+  if(!file) return;
+
+  // hand over the last partial block, then let the writer drain the queue and finish
+  if(block->count) submitBlock();
+  delete block;
+  block = NULL;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    closing = true;
+  }
+  blockReady.notify_one();
+  writer.join();
+  for(Block* b : freeBlocks) delete b;
+  freeBlocks.clear();
+
+  if(format == CAPTURE_WAV16) {
+    fseek(file, 0, SEEK_SET);
+    writeHeader();
+  }
+  fclose(file);
+  file = NULL;
+}
+
+void AudioCapture::submitBlock() {
+  // queue the full block, and carry on with a free one, or a new one if the writer is behind
+  // note: this only ever waits for the lock, never for the disk
+  Block* next = NULL;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    fullBlocks.push_back(block);
+    if(!freeBlocks.empty()) {
+      next = freeBlocks.back();
+      freeBlocks.pop_back();
+    }
+  }
+  blockReady.notify_one();
+  block = next ? next : new Block();
+  block->count = 0;
+}
+
+void AudioCapture::writerThread() {
+  float* converted = (format == CAPTURE_RAW_FLOAT) ? new float[2 * blockSize] : NULL;
+  while(true) {
+    Block* b;
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      blockReady.wait(guard, [this] { return !fullBlocks.empty() || closing; });
+      if(fullBlocks.empty()) break;  // closing, and everything is written
+      b = fullBlocks.front();
+      fullBlocks.pop_front();
+    }
+
+    if(format == CAPTURE_WAV16) {
+      // note: WAV is little-endian, as are the hosts this runs on
+      fwrite(b->samples, sizeof(int16_t), 2 * b->count, file);
+    } else {
+      for(int i = 0; i < 2 * b->count; i++) converted[i] = b->samples[i] * (1.0f / 32768.0f);
+      fwrite(converted, sizeof(float), 2 * b->count, file);
+    }
+    samplesWritten += b->count;
+
+    std::lock_guard<std::mutex> guard(lock);
+    freeBlocks.push_back(b);
+  }
+  delete[] converted;
+}
+
+void AudioCapture::writeHeader() {
+  // canonical 44-byte header for 16-bit stereo PCM
+  uint32_t dataSize = samplesWritten * 4;
+  uint8_t header[44];
+  auto put16 = [&](int offset, uint16_t value) { header[offset] = value; header[offset + 1] = value >> 8; };
+  auto put32 = [&](int offset, uint32_t value) { put16(offset, value); put16(offset + 2, value >> 16); };
+  memcpy(header, "RIFF", 4);
+  put32(4, 36 + dataSize);
+  memcpy(header + 8, "WAVEfmt ", 8);
+  put32(16, 16);  // fmt chunk size
+  put16(20, 1);  // PCM
+  put16(22, 2);  // channels
+  put32(24, sampleRate);
+  put32(28, sampleRate * 4);  // bytes per second
+  put16(32, 4);  // bytes per sample, across both channels
+  put16(34, 16);  // bits per sample
+  memcpy(header + 36, "data", 4);
+  put32(40, dataSize);
+  fwrite(header, 1, sizeof(header), file);
+}
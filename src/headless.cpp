@@ -0,0 +1,72 @@
+#include "dmg.hpp"
+#include "capture.hpp"
+
+class Headless : public DMG<Headless> {
+public:
+  Headless() {
+    frames = 0;
+    setRenderMode(RENDER_NEVER);  // nothing is displayed, so only keep the PPU's timing
+    setAudioEnabled(false);  // nor played
+  }
+
+  void frame() {
+    frames++;
+  }
+
+  void emitSamples(const int16_t* samples, int count) {
+    capture.write(samples, count);
+  }
+
+  void startCapture(const char* path, int format) {
+    setAudioEnabled(true);
+    setSampleRate(48000);
+    capture.open(path, format, 48000);
+  }
+
+  void stopCapture() {
+    capture.close();
+  }
+
+  void run(int frameLimit) {
+    while(frames < frameLimit) instruction();
+  }
+
+private:
+  int frames;
+  AudioCapture capture;
+};
+
+int main(int argc, char** argv) {
+  bool interpreter = false;
+  const char* capturePath = NULL;
+  int captureFormat = CAPTURE_WAV16;
+  bool validArgs = (argc >= 4);
+  for(int i = 4; i < argc; i++) {
+    if(!strcmp(argv[i], "--interpreter")) {
+      interpreter = true;
+    } else if(!strncmp(argv[i], "--wav=", 6)) {
+      capturePath = argv[i] + 6;
+      captureFormat = CAPTURE_WAV16;
+    } else if(!strncmp(argv[i], "--raw=", 6)) {
+      capturePath = argv[i] + 6;
+      captureFormat = CAPTURE_RAW_FLOAT;
+    } else {
+      validArgs = false;
+    }
+  }
+  if(!validArgs) {
+    printf("Usage: dmg-headless [BIOS_PATH] [CART_PATH] [FRAMES] [--interpreter] [--wav=PATH | --raw=PATH]\n");
+    exit(0);
+  }
+
+  Headless emulator;
+  emulator.blockCache = !interpreter;
+  emulator.loadBootROM(argv[1]);
+  emulator.loadCart(argv[2]);
+  if(capturePath) emulator.startCapture(capturePath, captureFormat);
+  emulator.run(atoi(argv[3]));
+  emulator.stopCapture();
+  emulator.save();
+
+  return 0;
+}
@@ -1,26 +1,156 @@
 #include <SDL2/SDL.h>
 #include "dmg.hpp"
+#include "palette.hpp"
 
-class Emulator : public DMG {
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// frame of shades drawn by the PPU
+struct Frame {
+  uint8_t shades[160 * 144];
+  uint64_t hash;  // of shades, to skip uploading a frame identical to the last one
+};
+
+// three frames shared between the emulation thread, which draws into the back frame, and the
+// presentation thread, which shows the front frame, so that neither waits for the other
+class TripleBuffer {
+public:
+  TripleBuffer() {
+    for(int i = 0; i < 3; i++) frames[i] = new Frame();
+    back = 0;
+    middle = 1;
+    front = 2;
+  }
+
+  ~TripleBuffer() {
+    for(int i = 0; i < 3; i++) delete frames[i];
+  }
+
+  Frame* backFrame() { return frames[back]; }
+  Frame* frontFrame() { return frames[front]; }
+
+  // called by the writer once the back frame is complete
+  void publish() { back = middle.exchange(back | fresh) & ~fresh; }
+
+  // called by the reader to swap in the latest complete frame, if there is a new one
+  bool update() {
+    if(!(middle.load() & fresh)) return false;
+    front = middle.exchange(front) & ~fresh;
+    return true;
+  }
+
+private:
+  static constexpr int fresh = 0x04;  // set in middle when it holds a frame the reader hasn't seen
+  Frame* frames[3];
+  int back;
+  std::atomic<int> middle;
+  int front;
+};
+
+// stereo samples passed from the emulation thread to the audio callback without locking
+class AudioRing {
+public:
+  AudioRing(int size) {
+    capacity = size;
+    samples = new int16_t[2 * capacity];
+    head = 0;
+    tail = 0;
+    last[0] = 0;
+    last[1] = 0;
+    underruns = 0;
+    overruns = 0;
+  }
+
+  ~AudioRing() {
+    delete[] samples;
+  }
+
+  int fill() { return head.load() - tail.load(); }
+
+  // called by the writer with interleaved left and right samples, dropping any that don't fit
+  void write(const int16_t* data, int count) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    int space = capacity - (h - tail.load(std::memory_order_acquire));
+    if(count > space) {
+      count = space;
+      overruns++;
+    }
+    for(int i = 0; i < count; i++) {
+      int index = (h + i) & (capacity - 1);
+      samples[2 * index] = data[2 * i];
+      samples[2 * index + 1] = data[2 * i + 1];
+    }
+    head.store(h + count, std::memory_order_release);
+  }
+
+  // called by the reader, holding the last samples if the ring runs dry
+  void read(int16_t* out, int count) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    int avail = head.load(std::memory_order_acquire) - t;
+    if(count > avail) underruns++;
+    int i = 0;
+    for(; i < count && i < avail; i++) {
+      int index = (t + i) & (capacity - 1);
+      out[2 * i] = samples[2 * index];
+      out[2 * i + 1] = samples[2 * index + 1];
+    }
+    if(i) {
+      last[0] = out[2 * i - 2];
+      last[1] = out[2 * i - 1];
+    }
+    for(; i < count; i++) {
+      out[2 * i] = last[0];
+      out[2 * i + 1] = last[1];
+    }
+    tail.store(t + (count < avail ? count : avail), std::memory_order_release);
+  }
+
+  std::atomic<int> underruns;
+  std::atomic<int> overruns;
+
+private:
+  int capacity;  // in stereo samples, must be power of 2
+  int16_t* samples;
+  std::atomic<uint32_t> head;  // total samples written
+  std::atomic<uint32_t> tail;  // total samples read
+  int16_t last[2];
+};
+
+class Emulator : public DMG<Emulator> {
 public:
-  Emulator() {
+  Emulator(int latency) {
     SDL_Init(SDL_INIT_EVERYTHING);
-    framebuffer = new uint32_t[width * height]();
+    running = true;
+    fastForward = false;
+    frames = new TripleBuffer();
+    frameHash = 1469598103934665603ULL;
+    shownHash = 0;
+    setFrameBuffer(frames->backFrame()->shades);
     window = SDL_CreateWindow("emuDMG", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width * scale, height * scale, SDL_WINDOW_SHOWN);
     renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
     texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, width, height);
 
     //init audio
     SDL_AudioSpec audioSpecRequested;
-    SDL_AudioSpec audioSpec;
-    audioSpecRequested.freq = 32768;
+    audioSpecRequested.freq = 48000;  //most devices run at 48 kHz, so SDL won't have to resample again
     audioSpecRequested.format = AUDIO_S16SYS;
-    audioSpecRequested.channels = 1;
+    audioSpecRequested.channels = 2;
     audioSpecRequested.samples = audioBufferSize;
-    audioSpecRequested.callback = NULL;  //no callback
-    audioSpecRequested.userdata = NULL;  //no parameter to callback
-    audioOut = SDL_OpenAudioDevice(NULL, 0, &audioSpecRequested, &audioSpec, SDL_AUDIO_ALLOW_ANY_CHANGE);
-    SDL_PauseAudioDevice(audioOut, 0);
+    audioSpecRequested.callback = audioCallback;
+    audioSpecRequested.userdata = this;
+    audioSpec = audioSpecRequested;
+    audioOut = SDL_OpenAudioDevice(NULL, 0, &audioSpecRequested, &audioSpec, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+    audioStarted = false;
+
+    //keep enough samples queued to cover the latency, and at least two callbacks' worth
+    audioTarget = audioSpec.freq * latency / 1000;
+    if(audioTarget < audioSpec.samples * 2) audioTarget = audioSpec.samples * 2;
+    int ringSize = 1;
+    while(ringSize < audioTarget * 2) ringSize <<= 1;
+    audio = new AudioRing(ringSize);
+    sampleRate = audioSpec.freq;  //resample to whatever rate the device runs at
+    setSampleRate(sampleRate);
   }
 
   ~Emulator() {
@@ -29,115 +159,105 @@ public:
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
-    delete[] framebuffer;
-    delete[] savePath;
-    delete cart;
-  }
-
-  void loadCart(char* fname) {
-    // load cartridge ROM
-    const int maxRomSize = 0x800000;  // MBC5 maximum ROM size (8MiB)
-    uint8_t* cartRom = new uint8_t[maxRomSize];
-    FILE* fc = fopen(fname, "rb");
-    if(!fc) {
-      printf("ERROR: %s is not a valid file path\n", fname);
-      exit(0);
-    }
-    int fsize = fread(cartRom, sizeof(uint8_t), maxRomSize, fc);
-    fclose(fc);
-    printf("Loaded %s\n", fname);
-
-    // pre-mirror cartridge ROM to fill 8MiB address space
-    for(int i = 0; (i + fsize) <= maxRomSize; i += fsize) memcpy(cartRom + i, cartRom, fsize);
-
-    // initialize mapper
-    uint8_t mapper = cartRom[0x0147];
-    bool hasRam = false;
-    switch(mapper) {
-    case 0x00:                cart = new Cart(); break;
-    case 0x01:                cart = new MBC1(); break;
-    case 0x02: hasRam = true; cart = new MBC1(); break;
-    case 0x03: hasRam = true; cart = new MBC1(); break;  // todo: has battery
-    case 0x19:                cart = new MBC5(); break;
-    case 0x1a: hasRam = true; cart = new MBC5(); break;
-    case 0x1b: hasRam = true; cart = new MBC5(); break;  // todo: has battery
-    case 0x1c:                cart = new MBC5(); break;  // todo: has rumble
-    case 0x1d: hasRam = true; cart = new MBC5(); break;  // todo: has rumble
-    case 0x1e: hasRam = true; cart = new MBC5(); break;  // todo: has battery and rumble
-    default:
-      printf("ERROR: Unsupported mapper (0x%02x)\n", mapper);
-      exit(0);
-      break;
+    delete frames;
+    delete audio;
+  }
+
+  void frame() {
+    //hand the frame over to the presentation thread, unless it was skipped, and draw the next one into a free buffer
+    if(frameDrawn()) {
+      frames->backFrame()->hash = frameHash;
+      frames->publish();
+      setFrameBuffer(frames->backFrame()->shades);
     }
-    printf("Mapper: 0x%02x\n", mapper);
-
-    // load cartridge RAM
-    uint8_t* cartRam = NULL;
-    uint32_t cartRamMask = 0x00000;
-    if(hasRam) {
-      switch(cartRom[0x0149]) {
-      case 0x02: cartRamMask = 0x01fff; break;
-      case 0x03: cartRamMask = 0x07fff; break;
-      case 0x04: cartRamMask = 0x1ffff; break;
-      case 0x05: cartRamMask = 0x0ffff; break;
-      default:
-        printf("Warning: Cartridge header specifies RAM without quantity (0x%02x)\n");
-        hasRam = false;
-        break;
+    frameHash = 1469598103934665603ULL;
+
+    //fast-forward while TAB is held, only drawing every 10th frame
+    setRenderMode(fastForward ? RENDER_INTERVAL : RENDER_ALL, 10);
+  }
+
+  void run() {
+    //run the core on its own thread, so it never waits for vsync
+    std::thread core([this] { while(running) instruction(); });
+
+    while(running) {
+      //check for window closing
+      SDL_Event event;
+      while(SDL_PollEvent(&event)) {
+        switch(event.type) {
+        case SDL_QUIT:
+          running = false;
+          break;
+        }
       }
-    }
-    if(hasRam) cartRam = new uint8_t[0x20000];  // maximum RAM size (128KiB)
-
-    // load save file, if present
-    // todo: only load save data if cart has battery
-    savePath = new char[strlen(fname) + 5];
-    sprintf(savePath, "%s.sav", fname);
-    if(hasRam) {
-      FILE* fs = fopen(savePath, "rb");
-      if(fs) {
-        fread(cartRam, sizeof(uint8_t), cartRamMask + 1, fs);
-        fclose(fs);
+
+      //forward input to the core
+      setJoypad(pollButtons(), pollDpad());
+      fastForward = SDL_GetKeyboardState(NULL)[SDL_SCANCODE_TAB];
+
+      //present the latest complete frame, converting it straight into the texture if it changed
+      if(frames->update() && frames->frontFrame()->hash != shownHash) {
+        uint8_t* pixels;
+        int pitch;
+        SDL_LockTexture(texture, NULL, (void**)&pixels, &pitch);
+        for(int y = 0; y < height; y++) palette.convertLine(frames->frontFrame()->shades + width * y, pixels + pitch * y);
+        SDL_UnlockTexture(texture);
+        shownHash = frames->frontFrame()->hash;
       }
+      SDL_RenderCopy(renderer, texture, NULL, NULL);
+      SDL_RenderPresent(renderer);
     }
 
-    // load cartridge
-    cart->load(cartRom, cartRam, cartRamMask);
+    core.join();
+    if(audioOut) printf("Audio underruns: %d, overruns: %d\n", audio->underruns.load(), audio->overruns.load());
+    save();
   }
 
-  void save() {
-    // todo: only write save data if cart has battery
-    uint8_t* saveData = cart->getRAM();
-    if(saveData) {
-      FILE* f = fopen(savePath, "wb");
-      fwrite(saveData, sizeof(uint8_t), cart->getSizeRAM(), f);
-      fclose(f);
+  void plotLine(int y, const uint8_t* data) {
+    //the line is already in the frame buffer, so only hash it
+    for(int x = 0; x < width; x += 8) {
+      uint64_t block;
+      memcpy(&block, data + x, 8);
+      frameHash = (frameHash ^ block) * 0x100000001b3ULL;
     }
   }
 
-  void frame() override {
-    //draw frame
-    SDL_UpdateTexture(texture, NULL, framebuffer, 4 * width);
-    SDL_RenderCopy(renderer, texture, NULL, NULL);
-    SDL_RenderPresent(renderer);
-
-    //check for window closing
-    SDL_Event event;
-    while(SDL_PollEvent(&event)) {
-      switch(event.type) {
-      case SDL_QUIT:
-        save();
-        exit(0);
-        return;
+  void emitSamples(const int16_t* samples, int count) {
+    if(fastForward) return;  //run flat out, dropping audio rather than waiting for it
+    if(audioOut) {
+      audio->write(samples, count);
+
+      //start playing once the target latency is queued, so the callback doesn't start off starved
+      if(!audioStarted && audio->fill() >= audioTarget) {
+        SDL_PauseAudioDevice(audioOut, 0);
+        audioStarted = true;
       }
     }
+
+    //pace emulation with the host timer, by the time this block covers at the rate it was resampled to
+    //note: blocks keep coming while the LCD is off, unlike frames
+    auto now = std::chrono::steady_clock::now();
+    nextBlock += std::chrono::nanoseconds((int64_t)(count * 1e9 / sampleRate));
+    if(nextBlock < now) nextBlock = now;  //fell behind, so don't try to catch up
+    std::this_thread::sleep_until(nextBlock);
+
+    //nudge the sample rate to hold the ring at the target fill, which also keeps emulation in step with the audio clock
+    if(audioOut) {
+      double error = (double)(audio->fill() - audioTarget) / audioTarget;
+      if(error < -1.0) error = -1.0;
+      if(error > 1.0) error = 1.0;
+      sampleRate = audioSpec.freq * (1.0 - maxRateDelta * error);
+      setSampleRate(sampleRate);
+    }
   }
 
-  void run() {
-    insertCart(cart);
-    for(;;) instruction();
+private:
+  static void audioCallback(void* userdata, Uint8* stream, int len) {
+    //runs on SDL's audio thread
+    ((Emulator*)userdata)->audio->read((int16_t*)stream, len / (2 * sizeof(int16_t)));
   }
 
-  uint8_t pollButtons() override {
+  uint8_t pollButtons() {
     //todo: support alternate key bindings
     uint8_t data = 0xff;
     const uint8_t* keys = SDL_GetKeyboardState(NULL);
@@ -148,7 +268,7 @@ public:
     return data;
   }
 
-  uint8_t pollDpad() override {
+  uint8_t pollDpad() {
     //todo: support alternate key bindings
     uint8_t data = 0xff;
     const uint8_t* keys = SDL_GetKeyboardState(NULL);
@@ -165,45 +285,40 @@ public:
     return data;
   }
 
-  void plotPixel(int x, int y, uint8_t data) override {
-    uint32_t colour = data ^ 0x03;  //convert palette value to colour
-    colour *= 0x555555;  //scale 2-bit colour to 24-bit
-    framebuffer[160 * y + x] = 0xff000000 | colour;
-  }
-
-  void emitSample(int16_t sample) override {
-    static int outCnt = 0;
-    outCnt++;
-    if(!(outCnt & 0x1f)) {
-      while(SDL_GetQueuedAudioSize(audioOut) > (audioBufferSize * 2)) {
-        SDL_Delay(1);  //prevent running too far ahead of audio
-      }
-      SDL_QueueAudio(audioOut, &sample, sizeof(int16_t));
-    }
-  }
-
-private:
   const int scale = 3;
   const int width = 160;
   const int height = 144;
-  const int audioBufferSize = 1024;  //must be power of 2
-  uint32_t* framebuffer;
+  const int audioBufferSize = 512;  //samples per callback, must be power of 2
+  const double maxRateDelta = 0.005;  //furthest the sample rate is adjusted from the device's
+  TripleBuffer* frames;
+  Palette palette;  //converts shades to RGBA32, on the presentation thread
+  uint64_t frameHash;  //of the lines drawn so far this frame
+  uint64_t shownHash;  //of the frame in the texture
   SDL_Window* window;
   SDL_Renderer* renderer;
   SDL_Texture* texture;
   SDL_AudioDeviceID audioOut;
+  SDL_AudioSpec audioSpec;
+  int audioTarget;  //samples to keep in the ring
+  bool audioStarted;
+  double sampleRate;  //of the samples being emitted
+  std::chrono::steady_clock::time_point nextBlock;
+
+  //shared between the emulation and presentation threads
+  std::atomic<bool> running;
+  std::atomic<bool> fastForward;
 
-  char* savePath;
-  Cart* cart;
+  //shared between the emulation and audio threads
+  AudioRing* audio;
 };
 
 int main(int argc, char** argv) {
-  if(argc != 3) {
-    printf("Usage: dmg [BIOS_PATH] [CART_PATH]\n");
+  if(argc != 3 && argc != 4) {
+    printf("Usage: dmg [BIOS_PATH] [CART_PATH] [LATENCY_MS]\n");
     exit(0);
   }
 
-  Emulator emulator;
+  Emulator emulator(argc == 4 ? atoi(argv[3]) : 60);
   emulator.loadBootROM(argv[1]);
   emulator.loadCart(argv[2]);
   emulator.run();
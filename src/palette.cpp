@@ -0,0 +1,127 @@
+#include "palette.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+void Palette::setPalette(int pixelFormat, const uint32_t shadeColours[4]) {
+  if(pixelFormat < 0 || pixelFormat >= FORMAT_COUNT) {
+    printf("Unsupported pixel format: %d\n", pixelFormat);
+    exit(1);
+  }
+
+  bool changed = pixelFormat != format;
+  for(int i = 0; i < 4; i++) {
+    if(shadeColours[i] != colours[i]) changed = true;
+    colours[i] = shadeColours[i];
+  }
+  format = pixelFormat;
+  if(changed) buildLUT();
+}
+
+void Palette::buildLUT() {
+  for(int i = 0; i < 4; i++) {
+    uint8_t r = colours[i] >> 0;
+    uint8_t g = colours[i] >> 8;
+    uint8_t b = colours[i] >> 16;
+    switch(format) {
+    case FORMAT_RGBA32: lut[i] = colours[i]; break;
+    case FORMAT_RGB565: lut[i] = (r >> 3) << 11 | (g >> 2) << 5 | (b >> 3); break;
+    case FORMAT_GREY8: lut[i] = (r * 77 + g * 150 + b * 29) >> 8; break;  // luma
+    }
+  }
+}
+
+void Palette::convertLine(const uint8_t* line, void* out) {
+  switch(format) {
+  case FORMAT_RGBA32: convertRGBA32(line, (uint32_t*)out); return;
+  case FORMAT_RGB565: convertRGB565(line, (uint16_t*)out); return;
+  case FORMAT_GREY8: convertGrey8(line, (uint8_t*)out); return;
+  }
+}
+
+void Palette::convertRGBA32(const uint8_t* line, uint32_t* out) {
+#if defined(__AVX2__)
+  // look up 8 pixels at a time
+  __m256i colour = _mm256_setr_epi32(lut[0], lut[1], lut[2], lut[3], lut[0], lut[1], lut[2], lut[3]);
+  for(int x = 0; x < 160; x += 8) {
+    __m256i shades = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(line + x)));
+    _mm256_storeu_si256((__m256i*)(out + x), _mm256_permutevar8x32_epi32(colour, shades));
+  }
+#elif defined(__SSE2__)
+  // select each pixel's colour with a mask per shade, 4 pixels at a time
+  __m128i zero = _mm_setzero_si128();
+  __m128i colour[4];
+  for(int i = 0; i < 4; i++) colour[i] = _mm_set1_epi32(lut[i]);
+  for(int x = 0; x < 160; x += 4) {
+    __m128i shades = _mm_cvtsi32_si128(*(const int32_t*)(line + x));
+    shades = _mm_unpacklo_epi16(_mm_unpacklo_epi8(shades, zero), zero);
+    __m128i pixels = zero;
+    for(int i = 0; i < 4; i++) pixels = _mm_or_si128(pixels, _mm_and_si128(_mm_cmpeq_epi32(shades, _mm_set1_epi32(i)), colour[i]));
+    _mm_storeu_si128((__m128i*)(out + x), pixels);
+  }
+#else
+  for(int x = 0; x < 160; x++) out[x] = lut[line[x] & 0x03];
+#endif
+}
+
+void Palette::convertRGB565(const uint8_t* line, uint16_t* out) {
+#if defined(__AVX2__)
+  // look up the low and high bytes of 16 pixels at a time, then interleave them
+  uint8_t lutLo[16] = {};
+  uint8_t lutHi[16] = {};
+  for(int i = 0; i < 4; i++) {
+    lutLo[i] = lut[i] >> 0;
+    lutHi[i] = lut[i] >> 8;
+  }
+  __m128i colourLo = _mm_loadu_si128((const __m128i*)lutLo);
+  __m128i colourHi = _mm_loadu_si128((const __m128i*)lutHi);
+  for(int x = 0; x < 160; x += 16) {
+    __m128i shades = _mm_loadu_si128((const __m128i*)(line + x));
+    __m128i lo = _mm_shuffle_epi8(colourLo, shades);
+    __m128i hi = _mm_shuffle_epi8(colourHi, shades);
+    _mm_storeu_si128((__m128i*)(out + x + 0), _mm_unpacklo_epi8(lo, hi));
+    _mm_storeu_si128((__m128i*)(out + x + 8), _mm_unpackhi_epi8(lo, hi));
+  }
+#elif defined(__SSE2__)
+  // select each pixel's colour with a mask per shade, 8 pixels at a time
+  __m128i zero = _mm_setzero_si128();
+  __m128i colour[4];
+  for(int i = 0; i < 4; i++) colour[i] = _mm_set1_epi16(lut[i]);
+  for(int x = 0; x < 160; x += 8) {
+    __m128i shades = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(line + x)), zero);
+    __m128i pixels = zero;
+    for(int i = 0; i < 4; i++) pixels = _mm_or_si128(pixels, _mm_and_si128(_mm_cmpeq_epi16(shades, _mm_set1_epi16(i)), colour[i]));
+    _mm_storeu_si128((__m128i*)(out + x), pixels);
+  }
+#else
+  for(int x = 0; x < 160; x++) out[x] = lut[line[x] & 0x03];
+#endif
+}
+
+void Palette::convertGrey8(const uint8_t* line, uint8_t* out) {
+#if defined(__AVX2__)
+  // look up 32 pixels at a time
+  __m256i colour = _mm256_setr_epi8(lut[0], lut[1], lut[2], lut[3], 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                    lut[0], lut[1], lut[2], lut[3], 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  for(int x = 0; x < 160; x += 32) {
+    __m256i shades = _mm256_loadu_si256((const __m256i*)(line + x));
+    _mm256_storeu_si256((__m256i*)(out + x), _mm256_shuffle_epi8(colour, shades));
+  }
+#elif defined(__SSE2__)
+  // select each pixel's colour with a mask per shade, 16 pixels at a time
+  __m128i colour[4];
+  for(int i = 0; i < 4; i++) colour[i] = _mm_set1_epi8(lut[i]);
+  for(int x = 0; x < 160; x += 16) {
+    __m128i shades = _mm_loadu_si128((const __m128i*)(line + x));
+    __m128i pixels = _mm_setzero_si128();
+    for(int i = 0; i < 4; i++) pixels = _mm_or_si128(pixels, _mm_and_si128(_mm_cmpeq_epi8(shades, _mm_set1_epi8(i)), colour[i]));
+    _mm_storeu_si128((__m128i*)(out + x), pixels);
+  }
+#else
+  for(int x = 0; x < 160; x++) out[x] = lut[line[x] & 0x03];
+#endif
+}
@@ -0,0 +1,26 @@
+#include "scheduler.hpp"
+
+void Scheduler::schedule(int event, uint64_t time) {
+  eventTime[event] = time;
+  findNext();
+}
+
+int Scheduler::pop() {
+  // return the highest-priority event that is due, or -1 if none are due
+  if(clock < nextTime) return -1;
+  for(int i = 0; i < EVENT_COUNT; i++) {
+    if(eventTime[i] <= clock) {
+      eventTime[i] = NEVER;
+      findNext();
+      return i;
+    }
+  }
+  return -1;
+}
+
+void Scheduler::findNext() {
+  nextTime = NEVER;
+  for(int i = 0; i < EVENT_COUNT; i++) {
+    if(eventTime[i] < nextTime) nextTime = eventTime[i];
+  }
+}